@@ -0,0 +1,151 @@
+#ifndef BENCH_H_INCL
+#define BENCH_H_INCL
+
+#include "mimic.h"
+
+// Size of the RAM stand-in for the EEPROM used while benchmarking
+#define BENCH_EEPROM_SIZE   128
+
+// Length of the scripted button press used to time check_button()
+#define BENCH_PRESS_MS      80
+
+
+// The BenchEeprom class has the same get()/put() interface as the EEPROM
+// library but keeps the data in RAM, so the storage functions can be timed
+// over and over without wearing out the real EEPROM
+//
+class BenchEeprom {
+protected:
+  uint8_t data[BENCH_EEPROM_SIZE];
+
+public:
+  BenchEeprom() {
+    memset(data, 0, sizeof(data));
+  }
+
+  template <class T>
+  T &get(int addr, T &t) {
+    if (addr >= 0 && addr + sizeof(T) <= sizeof(data))
+      memcpy(&t, data + addr, sizeof(T));
+    return t;
+  }
+
+  template <class T>
+  const T &put(int addr, const T &t) {
+    if (addr >= 0 && addr + sizeof(T) <= sizeof(data))
+      memcpy(data + addr, &t, sizeof(T));
+    return t;
+  }
+};
+
+
+// The BenchStream class is a Stream that reads back the same few bytes
+// each time it is rewound, so the serial parsing can be timed without
+// waiting on a real port.  Anything written to it is thrown away
+//
+class BenchStream : public Stream {
+protected:
+  const uint8_t *data;
+  uint8_t size, pos;
+
+public:
+  BenchStream() : data(nullptr), size(0), pos(0) {
+  }
+
+  void load(const uint8_t *bytes, uint8_t num) {
+    data = bytes;
+    size = num;
+    pos = 0;
+  }
+
+  void rewind() {
+    pos = 0;
+  }
+
+  int available() override {
+    return size - pos;
+  }
+
+  int read() override {
+    return (pos < size) ? data[pos++] : -1;
+  }
+
+  int peek() override {
+    return (pos < size) ? data[pos] : -1;
+  }
+
+  using Print::write;
+  size_t write(uint8_t c) override {
+    UNUSED(c);
+    return 1;
+  }
+};
+
+
+// Timer1 is used as a free running cycle counter while benchmarking.
+// The servos are never attached in a benchmark build so the Servo
+// library leaves Timer1 alone.  The counter wraps every 4.096 ms at
+// 16 MHz so anything longer only reports the micros() average
+//
+#if defined(__AVR__) && defined(TCCR1B) && defined(TOV1)
+#define BENCH_CYCLES
+#endif
+
+inline void benchTimerStart() {
+#ifdef BENCH_CYCLES
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);   // no prescaler: one count per cpu cycle
+  TIMSK1 = 0;
+#endif
+}
+
+
+// Run 'fn' the specified number of times and report the average time
+// per call in microseconds (to 0.01 uS) and the fewest cpu cycles seen
+// for one call.  Host builds have no cycle counter
+//
+inline void bench(const __FlashStringHelper *name, void (*fn)(void), int iterations) {
+  uint16_t best = 0xFFFF;
+
+#ifdef BENCH_CYCLES
+  // measure the cost of the measurement itself so it can be removed
+  uint16_t overhead = 0xFFFF;
+  for (int i=0; i < 4; i++) {
+    uint16_t start = TCNT1;
+    uint16_t cycles = TCNT1 - start;
+    if (cycles < overhead)
+      overhead = cycles;
+  }
+#endif
+
+  uint32_t total = micros();
+  for (int i=0; i < iterations; i++) {
+#ifdef BENCH_CYCLES
+    TIFR1 = _BV(TOV1);
+    uint16_t start = TCNT1;
+    fn();
+    uint16_t cycles = TCNT1 - start;
+    if (!(TIFR1 & _BV(TOV1)) && cycles - overhead < best)
+      best = cycles - overhead;
+#else
+    fn();
+#endif
+  }
+  total = micros() - total;
+
+  // hundredths of a microsecond per call
+  uint32_t average = total * 100UL / iterations;
+
+  char buff[24];
+  Serial.print(name);
+  snprintf(buff, sizeof(buff), " %5d x %7lu.%02lu uS", iterations,
+    (unsigned long) (average / 100), (unsigned long) (average % 100));
+  Serial.print(buff);
+  if (best != 0xFFFF) {
+    snprintf(buff, sizeof(buff), " %6u cycles", best);
+    Serial.print(buff);
+  }
+  Serial.println();
+}
+
+#endif // #ifndef BENCH_H_INCL
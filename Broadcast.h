@@ -0,0 +1,244 @@
+#ifndef BROADCAST_H_INCL
+#define BROADCAST_H_INCL
+
+#include "mimic.h"
+
+// Frames are sent by the leader this often (in milliseconds).
+// A frame is 12 bytes, about 1 mS per hop at 115200 baud
+#define BROADCAST_MS      40
+
+// A follower that hasn't had a good frame for this long (in milliseconds)
+// takes the leader as gone and picks the sequence up afresh from the next frame
+#define BROADCAST_TIMEOUT_MS  (3 * BROADCAST_MS)
+
+#define BROADCAST_SYNC    0xA5
+#define BROADCAST_FRAME   12
+
+// Latencies are kept in units of this many microseconds
+#define BROADCAST_TICK_US 10
+
+// Positions are sent as a fraction of the sending arm's calibrated range
+// (0 - BROADCAST_SCALE) so each follower can map them onto its own range
+#define BROADCAST_SCALE   4095
+
+// The role is kept in the last byte of the EEPROM, after the recordings
+#define BROADCAST_ROLE_ADDR   E2END
+
+enum BroadcastRole : uint8_t { BROADCAST_OFF, BROADCAST_LEADER, BROADCAST_FOLLOWER };
+
+
+// The Broadcast class streams the leader's mapped output arm positions as
+// compact frames over a serial port.  Followers check each frame, keep the
+// position in 'arm' (so it can be mapped onto their own output arm), and pass
+// it on downstream with the hop count and latency updated.
+//
+// The sketch runs the chain on the hardware Serial port (TX of each unit to
+// RX of the next).  The UART is interrupt driven and takes a few microseconds
+// of cpu per byte, so a follower receiving and forwarding a frame every 40 mS
+// spends well under 1% of its time on the link and the servo pulses aren't
+// held up.  SoftwareSerial would turn interrupts off for a whole byte time.
+//
+// Frame layout:
+//   [0]      BROADCAST_SYNC
+//   [1]      sequence number
+//   [2]      hops from the leader
+//   [3..4]   latency from the leader in BROADCAST_TICK_US units, LSB first (saturates at 65535)
+//   [5..10]  pinch, wrist, elbow, waist as packed 12-bit values
+//   [11]     8-bit sum of bytes 1 - 10
+//
+class Broadcast {
+protected:
+  Limits range;
+  uint8_t frame[BROADCAST_FRAME];
+  uint8_t fill;         // bytes of the incoming frame received so far
+  uint32_t lastSend;
+  uint32_t lastPoll;    // micros() when the port was last found empty
+  uint32_t syncUs;      // micros() when the sync byte of the incoming frame arrived
+  uint32_t lastFrame;   // millis() when the last good frame arrived
+  uint16_t byteUs;      // time to send one byte at the port baud rate
+  bool synced;
+
+  static uint8_t checksum(uint8_t *data) {
+    uint8_t sum = 0;
+    for (int i=1; i < BROADCAST_FRAME - 1; i++)
+      sum += data[i];
+    return sum;
+  }
+
+  void pack(Pos &pos) {
+    frame[5] = pos.pinch & 0xFF;
+    frame[6] = ((pos.pinch >> 8) & 0x0F) | ((pos.wrist & 0x0F) << 4);
+    frame[7] = (pos.wrist >> 4) & 0xFF;
+    frame[8] = pos.elbow & 0xFF;
+    frame[9] = ((pos.elbow >> 8) & 0x0F) | ((pos.waist & 0x0F) << 4);
+    frame[10] = (pos.waist >> 4) & 0xFF;
+  }
+
+  void unpack(Pos &pos) {
+    pos.pinch = frame[5] | ((frame[6] & 0x0F) << 8);
+    pos.wrist = (frame[6] >> 4) | (frame[7] << 4);
+    pos.elbow = frame[8] | ((frame[9] & 0x0F) << 8);
+    pos.waist = (frame[9] >> 4) | (frame[10] << 4);
+  }
+
+  void transmit(Stream &port) {
+    frame[BROADCAST_FRAME - 1] = checksum(frame);
+    port.write(frame, BROADCAST_FRAME);
+  }
+
+  // Estimate when a byte that has just been read arrived: at least as long
+  // ago as the bytes queued behind it took on the wire, but not before the
+  // last poll found the port empty
+  //
+  uint32_t arrival(int queued) {
+    uint32_t now = micros();
+    uint32_t ago = (uint32_t) queued * byteUs;
+    if (ago > now - lastPoll)
+      ago = now - lastPoll;
+    return now - ago;
+  }
+
+public:
+  uint8_t role;
+  uint8_t seq;          // leader: last sequence sent, follower: last sequence received
+  uint8_t hops;         // follower: our position in the chain (1 = next to the leader)
+  uint16_t latency;     // follower: time from the leader to us for the last frame (BROADCAST_TICK_US units)
+  uint16_t hopLatency;  // follower: time the last frame spent on the wire and in this unit
+  uint16_t received, dropped, errors;
+  Arm arm;              // follower: last received position in the broadcast range
+
+  Broadcast() :
+    range(),
+    fill(0),
+    lastSend(0),
+    lastPoll(0),
+    syncUs(0),
+    lastFrame(0),
+    byteUs(0),
+    synced(false),
+    role(BROADCAST_OFF),
+    seq(0),
+    hops(0),
+    latency(0),
+    hopLatency(0),
+    received(0),
+    dropped(0),
+    errors(0),
+    arm(0, 0, 0, 0, range) {
+    arm.range.b = Pos(BROADCAST_SCALE, BROADCAST_SCALE, BROADCAST_SCALE, BROADCAST_SCALE);
+  }
+
+  // Take on a role and clear the counters.
+  // 'baud' is the rate of the port the frames travel on
+  //
+  void begin(uint8_t r, long baud) {
+    role = r;
+    seq = hops = latency = hopLatency = 0;
+    received = dropped = errors = 0;
+    synced = false;
+    fill = 0;
+    byteUs = (10 * 1000000L + baud - 1) / baud;
+    lastSend = lastFrame = millis();
+    lastPoll = micros();
+  }
+
+  // Leader: send a position (in the given calibrated range)
+  // if it is time for the next frame
+  //
+  void send(Stream &port, Pos &pos, Limits &limits) {
+    if (role != BROADCAST_LEADER || millis() - lastSend < BROADCAST_MS)
+      return;
+    lastSend = millis();
+
+    Pos scaled(
+      constrain(map(pos.pinch, limits.a.pinch, limits.b.pinch, 0, BROADCAST_SCALE), 0, BROADCAST_SCALE),
+      constrain(map(pos.wrist, limits.a.wrist, limits.b.wrist, 0, BROADCAST_SCALE), 0, BROADCAST_SCALE),
+      constrain(map(pos.elbow, limits.a.elbow, limits.b.elbow, 0, BROADCAST_SCALE), 0, BROADCAST_SCALE),
+      constrain(map(pos.waist, limits.a.waist, limits.b.waist, 0, BROADCAST_SCALE), 0, BROADCAST_SCALE));
+
+    frame[0] = BROADCAST_SYNC;
+    frame[1] = ++seq;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = 0;
+    pack(scaled);
+    transmit(port);
+  }
+
+  // Follower: read frames from the port, forward each good one downstream
+  // and keep its position in 'arm'.  Bytes are skipped until a sync byte is
+  // seen, and a frame with a bad checksum is rescanned from its next sync byte
+  // so a false sync doesn't cost us the real frame behind it.
+  // The latency of each hop is timed from when the frame's sync byte arrived,
+  // so the time it waited in the receive buffer is counted.
+  // Returns true if a new position was received
+  //
+  bool poll(Stream &port) {
+    bool result = false;
+
+    while (role == BROADCAST_FOLLOWER && port.available() > 0) {
+      uint8_t c = port.read();
+      if (fill == 0) {
+        if (c != BROADCAST_SYNC)
+          continue;
+        syncUs = arrival(port.available());
+      }
+      frame[fill++] = c;
+      if (fill < BROADCAST_FRAME)
+        continue;
+
+      fill = 0;
+
+      if (frame[BROADCAST_FRAME - 1] != checksum(frame)) {
+        errors++;
+        for (uint8_t i=1; i < BROADCAST_FRAME; i++) {
+          if (frame[i] == BROADCAST_SYNC) {
+            fill = BROADCAST_FRAME - i;
+            memmove(frame, frame + i, fill);
+            syncUs += i * byteUs;
+            break;
+          }
+        }
+        continue;
+      }
+
+      if (synced) {
+        dropped += (uint8_t) (frame[1] - seq - 1);
+      }
+      synced = true;
+      lastFrame = millis();
+      seq = frame[1];
+      hops = frame[2] + 1;
+      received++;
+      unpack(arm);
+      result = true;
+
+      // pass it on, adding the time since the sender started it: one
+      // byte time to the end of the sync byte and our time since then
+      uint32_t elapsed = (micros() - syncUs + byteUs) / BROADCAST_TICK_US;
+      hopLatency = min(elapsed, 0xFFFFUL);
+      latency = min(frame[3] + (frame[4] << 8) + (uint32_t) hopLatency, 0xFFFFUL);
+      frame[2] = hops;
+      frame[3] = latency & 0xFF;
+      frame[4] = latency >> 8;
+      transmit(port);
+    }
+
+    lastPoll = micros();
+    return result;
+  }
+
+  // Follower: returns true (once) when no good frame has arrived for
+  // BROADCAST_TIMEOUT_MS.  The frames that were missed aren't counted as
+  // dropped, since the leader may have restarted its sequence
+  //
+  bool expired() {
+    if (!synced || millis() - lastFrame < BROADCAST_TIMEOUT_MS)
+      return false;
+    synced = false;
+    fill = 0;
+    return true;
+  }
+};
+
+#endif // #ifndef BROADCAST_H_INCL
@@ -11,6 +11,7 @@
 #include "ButtonLib2.h"
 
 ButtonPressCallback bpcb = nullptr;
+ButtonReadCallback brcb = nullptr;
 
 // ====================================================================================================
 // Set up a specific input pin for use as a push button input.
@@ -26,6 +27,22 @@ void set_button_input(const char pin) {
 }
 
 
+// ====================================================================================================
+// Replace the digitalRead(...) used to sample the button pins with a callback.
+// 
+void set_button_read_callback(ButtonReadCallback cb) {
+  brcb = cb;
+}
+
+
+// ====================================================================================================
+// Read the raw level of a button pin (LOW == pressed) using the read callback if one is set
+// 
+int read_button(const char pin) {
+  return (nullptr != brcb) ? brcb(pin) : digitalRead(pin);
+}
+
+
 // ====================================================================================================
 // 
 // Get the state of a push button input
@@ -38,7 +55,7 @@ void set_button_input(const char pin) {
 bool button_pressed(const char pin) {
   unsigned long int presstime = millis() + KEYDBDELAY;
 
-  while (!digitalRead(pin)) {     // remember a pressed button returns LOW not HIGH
+  while (!read_button(pin)) {     // remember a pressed button returns LOW not HIGH
     if (millis() >= presstime) {
       return true;
     }
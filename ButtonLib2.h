@@ -32,6 +32,20 @@
 #define  ALLOWED_MULTIPRESS_DELAY (KEYDBDELAY * 7)  // the amount of time allowed between multiple "taps" to be considered part of the last "tap"
 
 typedef void (*ButtonPressCallback)(const char pin, const char state);
+typedef int  (*ButtonReadCallback)(const char pin);
+
+// ====================================================================================================
+// Replace the digitalRead(...) used to sample the button pins with a callback.
+// This allows button edges to be recorded or fed in from somewhere else (a trace,
+// a test script, etc.).  Pass nullptr to go back to reading the pins directly.
+// 
+void set_button_read_callback(ButtonReadCallback cb);
+
+
+// ====================================================================================================
+// Read the raw level of a button pin (LOW == pressed) using the read callback if one is set
+// 
+int read_button(const char pin);
 
 // ====================================================================================================
 // Set up a specific input pin for use as a push button input.
@@ -48,6 +48,17 @@ public:
     return waist = clip(analogReadAvg(waistPin), range.a.waist, range.b.waist);
   }
 
+  // Set the readings from somewhere other than the pots (a trace replay, etc.)
+  //
+  InputArm &set(Pos &pos) {
+    pinch = clip(pos.pinch, range.a.pinch, range.b.pinch);
+    wrist = clip(pos.wrist, range.a.wrist, range.b.wrist);
+    elbow = clip(pos.elbow, range.a.elbow, range.b.elbow);
+    waist = clip(pos.waist, range.a.waist, range.b.waist);
+
+    return *this;
+  }
+
   InputArm &read() {
     readPinch();
     readWrist();
@@ -24,6 +24,22 @@
 |*|  + SoftwareSerial port gives API to allow external read and write of input and output arms
 |*|  + SoftwareSerial API includes support for controlling playback, recording, and EEPROM storage
 |*|  + During playback the "pinch" potentiometer controls the playback speed
+|*|  + Mimic mode uses a fixed point alpha-beta filter per joint that rejects pot noise
+|*|      and predicts a few milliseconds ahead to cancel servo and loop lag.
+|*|      The filter gains can be tuned over the serial API
+|*|  + Defining TRACE_ENABLE keeps the latest input samples, button edges and serial commands
+|*|      in a ring with periodic keyframes of the control state, while the arm runs as usual.
+|*|      The trace can be dumped or uploaded over the serial API and replayed from its oldest
+|*|      keyframe, checking the servo positions against the later ones
+|*|  + Defining SERVO_ENGINE_HZ drives the servos from a single Timer1 interrupt instead of
+|*|      the Servo library. All joint changes are committed together at a frame boundary
+|*|      and the frame rate can be raised for digital servos
+|*|  + Leader/follower broadcast: a leader streams its mapped positions over the hardware
+|*|      Serial port and daisy-chained followers move with it, each mapped onto its own
+|*|      servo ranges, forwarding the frames downstream and counting latency and drops.
+|*|      The role is kept in the EEPROM and can be changed with a button gesture
+|*|  + Defining BENCHMARK times the motion, input, storage, button and command hot paths
+|*|      at startup and reports the results on the Serial monitor
 |*|  + Uses a lightweight template class for storage of recording, playback, and parking sequences
 |*|  + (hardware) Added a brace to pressure the wrist servo shaft so it stays
 |*|      pressed in (better: replace that servo)
@@ -37,6 +53,7 @@
 |*|   Double Click: ...............Enter Playback Mode:
 |*|     Any button press: .........Exit playback mode
 |*|   Double Click and Hold: ......Park the servo arm and save any recording to the EEPROM
+|*|   Triple Click: ...............Step the broadcast role: off, leader, follower
 |*| 
 |*| TODO:
 |*|  + Added readVcc() function to determine the Vcc being used.  This affects the potential
@@ -68,8 +85,25 @@
 #include "InputArm.h"
 #include "OutputArm.h"
 #include "ButtonLib2.h"
+#include "Trace.h"
+#include "Bench.h"
+#include "ServoEngine.h"
+#include "Broadcast.h"
 
 #define DEBUG_API
+#define BROADCAST_ENABLE
+
+// Uncomment to record and replay traces over the serial api.
+// Uses TRACE_EVENTS * 6 bytes of RAM plus the keyframes (see Trace.h)
+//#define TRACE_ENABLE
+
+// Uncomment to drive the servos from the frame synchronized Timer1 engine
+// at this many frames per second (50 for analog servos, up to 333 for digital)
+//#define SERVO_ENGINE_HZ   50
+
+// Uncomment to time the hot paths at startup (results on the Serial monitor).
+// The servos are not attached and recordings are kept in RAM instead of the EEPROM
+//#define BENCHMARK
 
 // ---------------------------------------------------------------------------------
 // Project specific pin connections
@@ -97,6 +131,10 @@
 // SoftSerial port for serial control
 #define SSERIAL_RX    10
 #define SSERIAL_TX    8
+#define SSERIAL_BAUD  9600
+
+// hardware Serial: the text api, or the broadcast link when a role is set
+#define SERIAL_BAUD   115200
 
 // ---------------------------------------------------------------------------------
 // Global variables
@@ -123,14 +161,35 @@ static OutputArm outArm(S1_PIN, S2_PIN, S3_PIN, S4_PIN, oRange);
 static LinkedList<Pos> saved;
 static AppState appState;
 
+#ifdef TRACE_ENABLE
+static Trace trace;
+#endif
+
+#ifdef BROADCAST_ENABLE
+static Broadcast broadcast;
+#endif
+
+#ifdef SERVO_ENGINE_HZ
+static ServoEngine servoEngine;
+#endif
+
+#ifdef BENCHMARK
+static BenchEeprom benchEeprom;
+#define EEPROM benchEeprom
+#endif
+
 // ---------------------------------------------------------------------------------
 
 void setup() {
   initSerial();
-  initSSerial(9600);
+  initSSerial(SSERIAL_BAUD);
   initLED();
   setLED(OFF);
   set_button_input(BUTTON);
+#ifdef TRACE_ENABLE
+  set_button_read_callback(traceButtonRead);
+  outArm.clock = traceClock;
+#endif
 
 // Uncomment to manually set up the potentiometer limits
 //  setup_pot_values();
@@ -159,9 +218,27 @@ void setup() {
 //  outArm.write(pos, 750, true);
 //  outArm.detach();
 
-  outArm.setMode(IncrementHalf);
+  outArm.setMode(Predict);
+
+#ifdef BENCHMARK
+  runBenchmarks();
+#endif
+
+#ifdef SERVO_ENGINE_HZ
+  servoEngine.begin(SERVO_ENGINE_HZ);
+  if (servoEngine.isRunning()) {
+    outArm.useEngine(&servoEngine);
+  }
+#endif
 
   setMode(IDLE);
+
+#ifdef BROADCAST_ENABLE
+  // come back in the role we were last given
+  uint8_t role = BROADCAST_OFF;
+  EEPROM.get(BROADCAST_ROLE_ADDR, role);
+  setRole(role);
+#endif
 }
 
 
@@ -188,6 +265,13 @@ void loop() {
     case DOUBLE_PRESS_LONG:
       parkArm();
       break;
+
+#ifdef BROADCAST_ENABLE
+    // gesture to step through the broadcast roles
+    case TRIPLE_PRESS_SHORT:
+      nextRole();
+      break;
+#endif
   }
 
   if (appState.mode == MIMIC) {
@@ -197,6 +281,11 @@ void loop() {
 
 
 void emulateSApi() {
+#ifdef BROADCAST_ENABLE
+  // a follower's Serial port is the link from upstream
+  if (broadcast.role == BROADCAST_FOLLOWER) return;
+#endif
+
   if (Serial.available() == 0) return;
 
   if (outArm.pinch + outArm.wrist + outArm.elbow + outArm.waist == 0) {
@@ -214,7 +303,6 @@ void emulateSApi() {
     delayMicroseconds(40000);
   } while (Serial.available() != lastAvailable);
 
-  SerialPacket pkt;
   char buff[16];
 
   memset(buff, 0, sizeof(buff));
@@ -224,6 +312,17 @@ void emulateSApi() {
   }
   buff[sizeof(buff) - 1] = 0;
 
+  SerialPacket pkt;
+  if (textToPacket(buff, pkt)) {
+    processPacket(pkt);
+  }
+}
+
+
+// Convert a text command ("A1500", "T1", etc.) to a packet.
+// Returns false if it isn't one of the api commands
+//
+bool textToPacket(const char *buff, SerialPacket &pkt) {
   switch(buff[0]) {
     case 'A':   // write waist
     case 'B':   // write elbow
@@ -241,12 +340,22 @@ void emulateSApi() {
     case 'Z':   // Stop playback
     case 'p':   // Park arm
     case 'M':   // Set Mode
+    case 'U':   // Set output arm update mode
+    case 'F':   // Set filter alpha
+    case 'G':   // Set filter beta
+    case 'L':   // Set filter lead time
+    case 'N':   // Set filter noise deadband
+    case 'T':   // Trace stop/record/replay/dump
+    case 'E':   // Set servo engine frame rate
+    case 'e':   // Read servo engine frame counters
+    case 'S':   // Set broadcast role
+    case 's':   // Read broadcast counters
 
       pkt.fields.cmd = buff[0];
       pkt.fields.value = atoi(buff + 1);
-      processPacket(pkt);
-      break;
+      return true;
   }
+  return false;
 }
 
 
@@ -289,8 +398,34 @@ void parkArm() {
 // mimic function
 
 void mimic(void) {
+#ifdef BROADCAST_ENABLE
+  // followers get their target from the broadcast frames
+  if (broadcast.role == BROADCAST_FOLLOWER) {
+    outArm.write();
+    return;
+  }
+#endif
+
+#ifdef TRACE_ENABLE
+  if (trace.state == TRACE_REPLAY) {
+    // a replay feeds the output arm only the input samples in the trace,
+    // timed by the trace clock, so every replay of it comes out the same
+    if (trace.sample(inArm)) {
+      outArm = inArm.set(trace.input);
+    }
+  } else {
+    outArm = inArm.read();
+    trace.sample(inArm);
+  }
+  outArm.write();
+#else
   outArm = inArm.read();
   outArm.write();
+#endif
+
+#ifdef BROADCAST_ENABLE
+  broadcast.send(Serial, outArm.target, outArm.range);
+#endif
 }
 
 // ==============================================================
@@ -405,7 +540,8 @@ void playback(int mS) {
 void saveToEeprom() {
   int count = 0;
   Node<Pos> *ptr = saved.head;
-  while (ptr != nullptr) {
+  // stop short of the broadcast role in the last byte
+  while (ptr != nullptr && sizeof(count) + (count + 1) * sizeof(Pos) <= BROADCAST_ROLE_ADDR) {
     EEPROM.put(sizeof(count) + count * sizeof(Pos), ptr->t);
     ptr = ptr->next;
     count++;
@@ -431,7 +567,7 @@ void loadFromEeprom() {
 
 void initSerial() {
   Serial.end();
-  Serial.begin(115200);
+  Serial.begin(SERIAL_BAUD);
   while (!Serial)
     ;
   Serial.flush();
@@ -495,7 +631,7 @@ int getButton() {
 }
 
 void waitForButtonRelease() {
-  while (!digitalRead(BUTTON))
+  while (!read_button(BUTTON))
     delay(5);
 }
 
@@ -512,30 +648,32 @@ void initSSerial(int baud) {
 
 
 void processPacket(SerialPacket &pkt) {
+#ifdef TRACE_ENABLE
+  if (pkt.fields.cmd != 'T' && pkt.fields.cmd != 'O') {
+    trace.recordCommand(pkt.fields.cmd, pkt.fields.value);
+  }
+#endif
+
   switch (pkt.fields.cmd) {
 
     // set output waist                   // Write Output Arm API
     case 'A':
-      outArm.waist = pkt.fields.value;
-      outArm.write();
+      outArm.writeJoint(WaistJoint, pkt.fields.value);
       break;
 
     // set output elbow
     case 'B':
-      outArm.elbow = pkt.fields.value;
-      outArm.write();
+      outArm.writeJoint(ElbowJoint, pkt.fields.value);
       break;
 
     // set output wrist
     case 'C':
-      outArm.wrist = pkt.fields.value;
-      outArm.write();
+      outArm.writeJoint(WristJoint, pkt.fields.value);
       break;
 
     // set output pinch
     case 'D':
-      outArm.pinch = pkt.fields.value;
-      outArm.write();
+      outArm.writeJoint(PinchJoint, pkt.fields.value);
       break;
 
     // get input waist                    // Read Input Arm API
@@ -609,29 +747,449 @@ void processPacket(SerialPacket &pkt) {
     case 'M':
       setMode(pkt.fields.value);
       break;
+
+    // Set output arm update mode         // Motion Filter API
+    case 'U':
+      if ((unsigned) pkt.fields.value <= Predict) {
+        outArm.setMode((UpdateMode) pkt.fields.value);
+      }
+      break;
+
+    // Set filter alpha gain (0 - 256 == 0.0 - 1.0)
+    case 'F':
+      outArm.gains.alpha = constrain(pkt.fields.value, 0, 256);
+      break;
+
+    // Set filter beta gain (0 - 256 == 0.0 - 1.0)
+    case 'G':
+      outArm.gains.beta = constrain(pkt.fields.value, 0, 256);
+      break;
+
+    // Set filter lead time in milliseconds
+    case 'L':
+      outArm.gains.lead = constrain(pkt.fields.value, 0, 50);
+      break;
+
+    // Set filter noise deadband in servo microseconds
+    case 'N':
+      outArm.gains.deadband = constrain(pkt.fields.value, 0, 255);
+      break;
+
+#ifdef SERVO_ENGINE_HZ
+    // Set servo engine frames per second // Servo Engine API
+    case 'E':
+      if (servoEngine.isRunning()) {
+        servoEngine.begin(pkt.fields.value);
+      }
+      break;
+
+    // get servo engine frame count and the number of frames that picked up new widths
+    case 'e':
+      {
+        uint32_t frames = servoEngine.frames();
+        uint32_t commits = servoEngine.commits();
+        sserial.write('e');
+        sserial.write((uint8_t *) &frames, sizeof(frames));
+        sserial.write((uint8_t *) &commits, sizeof(commits));
+      }
+      break;
+#endif
+
+#ifdef BROADCAST_ENABLE
+    // Set broadcast role                 // Broadcast API
+    //   0 = off, 1 = leader, 2 = follower
+    case 'S':
+      if ((unsigned) pkt.fields.value <= BROADCAST_FOLLOWER) {
+        setRole(pkt.fields.value);
+      }
+      break;
+
+    // get broadcast counters: role, hops, then latency from the leader and latency
+    // of the last hop (10 uS units), frames received, dropped, and bad (16 bits each)
+    case 's':
+      sserial.write('s');
+      sserial.write(broadcast.role);
+      sserial.write(broadcast.hops);
+      sserial.write((uint8_t *) &broadcast.latency, sizeof(broadcast.latency));
+      sserial.write((uint8_t *) &broadcast.hopLatency, sizeof(broadcast.hopLatency));
+      sserial.write((uint8_t *) &broadcast.received, sizeof(broadcast.received));
+      sserial.write((uint8_t *) &broadcast.dropped, sizeof(broadcast.dropped));
+      sserial.write((uint8_t *) &broadcast.errors, sizeof(broadcast.errors));
+      break;
+#endif
+
+#ifdef TRACE_ENABLE
+    // Trace control                      // Trace API
+    //   0 = stop, 1 = record, 2 = replay, 3 = dump the trace
+    case 'T':
+      switch (pkt.fields.value) {
+        case 0: startTrace(TRACE_OFF);      break;
+        case 1: startTrace(TRACE_RECORD);   break;
+        case 2: startTrace(TRACE_REPLAY);   break;
+        case 3: trace.dump(sserial);        break;
+      }
+      break;
+
+    // Upload a trace: the packet is followed by
+    // a trace dump without its leading 'T'
+    case 'O':
+      startTrace(TRACE_OFF);
+      sserial.write('O');
+      sserial.write(trace.load(sserial) ? 1 : 0);
+      break;
+#endif
   }
 }
 
 void processSSerial() {
+#ifdef TRACE_ENABLE
+  // first, so the keyframes fall at the start of a loop pass
+  pumpTrace();
+#endif
+
 #ifdef DEBUG_API
   emulateSApi();
-#endif  
-
-  if (sserial.available() < (int) sizeof(SerialPacket))
-    return;
+#endif
+
+#ifdef BROADCAST_ENABLE
+  // a follower takes its frames from upstream on the Serial port,
+  // its control port works as usual
+  if (broadcast.role == BROADCAST_FOLLOWER) {
+    if (broadcast.poll(Serial) && appState.mode == MIMIC) {
+      outArm = broadcast.arm;
+    } else if (broadcast.expired()) {
+      // the leader has gone quiet: hold the last position without
+      // carrying on along its velocity
+      outArm.resetFilters();
+    }
+  }
+#endif
 
   SerialPacket pkt;
+  if (readPacket(sserial, pkt)) {
+    processPacket(pkt);
+  }
+}
+
+// Read a packet from the port once all of it has arrived
+//
+bool readPacket(Stream &port, SerialPacket &pkt) {
+  if (port.available() < (int) sizeof(SerialPacket))
+    return false;
 
   for (unsigned i=0; i < sizeof(SerialPacket); i++)
-    pkt.data[i] = sserial.read();
+    pkt.data[i] = port.read();
 
   // pkt.data[0] := command byte
   // pkt.data[1] := command value LSB (if 'set' command, otherwise ignored for 'get' commands)
   // pkt.data[2] := command value MSB (if 'set' command, otherwise ignored for 'get' commands)
 
-  processPacket(pkt);
+  return true;
+}
+
+
+// ==============================================================
+// Broadcast functions
+
+#ifdef BROADCAST_ENABLE
+
+// Take on a broadcast role and keep it in the EEPROM so the unit comes
+// back in the same role after a power cycle.  The frames travel on the
+// Serial port, so a follower has no text api and anything a leader
+// prints on it goes down the chain.  Followers start mimicking the
+// frames from upstream straight away
+//
+void setRole(uint8_t role) {
+  if (role > BROADCAST_FOLLOWER) {
+    role = BROADCAST_OFF;     // erased EEPROM
+  }
+  broadcast.begin(role, SERIAL_BAUD);
+  EEPROM.put(BROADCAST_ROLE_ADDR, role);
+
+  if (role == BROADCAST_FOLLOWER) {
+    setMode(MIMIC);
+  }
+}
+
+// Step to the next role and flash it on the LED: orange once
+// for off, green twice for a leader, red three times for a follower
+//
+void nextRole() {
+  static const LedColor colors[] = { ORANGE, GREEN, RED };
+
+  uint8_t role = (broadcast.role + 1) % 3;
+  waitForButtonRelease();
+  flashLED(colors[role], OFF, role + 1, 200, true);
+  setRole(role);
+}
+
+#endif
+
+// ==============================================================
+// Trace functions
+
+#ifdef TRACE_ENABLE
+
+// Start or stop recording or replaying a trace.  A replay puts back the
+// state saved in the oldest keyframe (the modes, filter gains, button level
+// and servo positions) and starts the filters afresh from there
+//
+void startTrace(uint8_t state) {
+  bool replaying = (trace.state == TRACE_REPLAY);
+  trace.begin(state);
+
+  if (trace.state == TRACE_RECORD) {
+    trace.level = digitalRead(BUTTON);
+    traceKeyframe();
+    return;
+  }
+  if (trace.state == TRACE_OFF) {
+    if (replaying) {
+      // the filters go back to micros() from the trace clock
+      outArm.resetFilters();
+    }
+    return;
+  }
+
+  TraceKey &key = trace.start();
+  setMode(key.mode);
+  outArm.gains = key.gains;
+  outArm.setMode(Immediate);
+  outArm = key.output;
+  outArm.write();
+  outArm.setMode((UpdateMode) key.update);
+  inArm.set(key.input);
+}
+
+// Save a keyframe of the control state to the trace being recorded
+//
+void traceKeyframe() {
+  TraceKey key;
+  key.input = inArm.read();
+  key.output = outArm;
+  key.mode = appState.mode;
+  key.update = outArm.getMode();
+  key.level = trace.level;
+  key.gains = outArm.gains;
+  trace.keyframe(key);
+}
+
+// Save a keyframe of the control state when one is due while recording,
+// or check the servo positions against it when a replay gets there.
+// Then feed any replayed commands that are due back through processPacket().
+// When the replay finishes the number of mismatched keyframes and the
+// largest difference seen are reported
+//
+void pumpTrace() {
+  if (trace.keyDue()) {
+    traceKeyframe();
+  } else if (trace.keyReached()) {
+    trace.checkKey(outArm);
+  }
+
+  TraceEvent *ev;
+  while ((ev = trace.step(true)) != nullptr) {
+    SerialPacket pkt;
+    pkt.fields.cmd = Trace::command(*ev);
+    pkt.fields.value = Trace::commandValue(*ev);
+    processPacket(pkt);
+  }
+
+  if (trace.finished() == TRACE_REPLAY) {
+    sserial.write('r');
+    sserial.write(trace.mismatches & 0xFF);
+    sserial.write((trace.mismatches >> 8) & 0xFF);
+    sserial.write(trace.worst & 0xFF);
+    sserial.write((trace.worst >> 8) & 0xFF);
+    // the filters go back to micros() from the trace clock
+    outArm.resetFilters();
+  }
+}
+
+// Time source for the output arm's filters: the trace clock
+// while a trace is running, otherwise micros()
+//
+unsigned long traceClock() {
+  return trace.timed() ? trace.now() * 1000UL : micros();
+}
+
+// Button read callback used by check_button().  Records the button
+// edges, or supplies them from the trace when one is being replayed
+//
+int traceButtonRead(const char pin) {
+  if (trace.state == TRACE_REPLAY) {
+    trace.step(false);
+  } else {
+    trace.recordButton(digitalRead(pin));
+  }
+  return trace.level;
+}
+
+#endif
+
+// ==============================================================
+// Benchmark functions
+
+#ifdef BENCHMARK
+
+static bool benchFlip, benchPressed;
+static uint32_t benchPressStart;
+static SerialPacket benchPacket;
+static BenchStream benchStream;
+
+// Alternate the output arm target between the ends of its range
+// and update the servos so every write() has work to do
+//
+void benchWrite() {
+  benchFlip = !benchFlip;
+  outArm.target = benchFlip ? oRange1 : oRange2;
+  outArm.write();
+}
+
+// Alternate the input arm between the ends of its range and map it
+// onto the output arm the way mimic() does, so every update mode
+// (including Predict, which only moves on new readings) has work to do
+//
+void benchMapWrite() {
+  benchFlip = !benchFlip;
+  outArm = inArm.set(benchFlip ? iRange1 : iRange2);
+  outArm.write();
+}
+
+// Button read callback that follows a script: released, or pressed
+// for BENCH_PRESS_MS starting at benchPressStart when benchPressed is set
+//
+int benchButtonRead(const char pin) {
+  UNUSED(pin);
+  return (benchPressed && millis() - benchPressStart < BENCH_PRESS_MS) ? LOW : HIGH;
+}
+
+void runBenchmarks() {
+  Serial.println(F("Mimic benchmarks: name, iterations x average, fewest cycles"));
+  benchTimerStart();
+  outArm.detach();
+
+  UpdateMode lastMode = outArm.getMode();
+
+  // output arm motion
+  outArm.setMode(Immediate);
+  bench(F("write() Immediate     "), benchWrite, 200);
+  outArm.setMode(Increment1);
+  bench(F("write() Increment1    "), benchWrite, 200);
+  outArm.setMode(IncrementHalf);
+  bench(F("write() IncrementHalf "), benchWrite, 200);
+  outArm.setMode(IncrementTime);
+  bench(F("write() IncrementTime "), benchWrite, 200);
+  bench(F("calcIncs()            "), []() { outArm.calcIncs(); }, 200);
+
+  // a new input reading mapped onto the output arm and written out
+  outArm.setMode(Immediate);
+  bench(F("map+write Immediate   "), benchMapWrite, 200);
+  outArm.setMode(Increment1);
+  bench(F("map+write Increment1  "), benchMapWrite, 200);
+  outArm.setMode(IncrementHalf);
+  bench(F("map+write IncrHalf    "), benchMapWrite, 200);
+  outArm.setMode(IncrementTime);
+  bench(F("map+write IncrTime    "), benchMapWrite, 200);
+  outArm.setMode(Predict);
+  bench(F("map+write Predict     "), benchMapWrite, 200);
+
+  // input arm mapping onto the output arm
+  inArm.set(iRange2);
+  outArm.setMode(IncrementHalf);
+  bench(F("Arm = map IncrHalf    "), []() { outArm = inArm; }, 200);
+  outArm.setMode(Predict);
+  bench(F("Arm = map Predict     "), []() { outArm = inArm; }, 200);
+  bench(F("mimic()               "), mimic, 100);
+
+  // recording storage
+  static LinkedList<Pos> list;
+  bench(F("list addTail x10+clear"), []() {
+    for (int i=0; i < 10; i++)
+      list.addTail(oRange1);
+    list.clear();
+  }, 50);
+
+  for (int i=0; i < 10; i++)
+    list.addTail(oRange2);
+  bench(F("list iterate x10      "), []() {
+    static volatile unsigned sum;
+    for (Node<Pos> *ptr = list.head; ptr != nullptr; ptr = ptr->next)
+      sum += ptr->t.waist;
+  }, 200);
+  list.clear();
+
+  for (int i=0; i < 10; i++)
+    saved.addTail(oRange1);
+  bench(F("saveToEeprom() x10    "), saveToEeprom, 50);
+  bench(F("loadFromEeprom() x10  "), loadFromEeprom, 50);
+  saved.clear();
+
+  // button gestures
+  set_button_read_callback(benchButtonRead);
+  bench(F("check_button() idle   "), []() {
+    char state = NOT_PRESSED;
+    check_button(BUTTON, state);
+  }, 200);
+  bench(F("check_button() press  "), []() {
+    char state = NOT_PRESSED;
+    benchPressStart = millis();
+    benchPressed = true;
+    check_button(BUTTON, state);
+    benchPressed = false;
+  }, 3);
+#ifdef TRACE_ENABLE
+  set_button_read_callback(traceButtonRead);
+#else
+  set_button_read_callback(nullptr);
+#endif
+
+  // serial api commands
+  bench(F("processPacket() F     "), []() {
+    SerialPacket pkt;
+    pkt.fields.cmd = 'F';
+    pkt.fields.value = DEFAULT_ALPHA;
+    processPacket(pkt);
+  }, 200);
+  bench(F("processPacket() N     "), []() {
+    SerialPacket pkt;
+    pkt.fields.cmd = 'N';
+    pkt.fields.value = DEFAULT_DEADBAND;
+    processPacket(pkt);
+  }, 200);
+
+  // the same command through the binary and the text parsers
+  benchPacket.fields.cmd = 'F';
+  benchPacket.fields.value = DEFAULT_ALPHA;
+  benchStream.load(benchPacket.data, sizeof(benchPacket.data));
+  bench(F("readPacket() F        "), []() {
+    SerialPacket pkt;
+    benchStream.rewind();
+    if (readPacket(benchStream, pkt)) {
+      processPacket(pkt);
+    }
+  }, 200);
+  bench(F("textToPacket() F      "), []() {
+    SerialPacket pkt;
+    if (textToPacket("F128", pkt)) {
+      processPacket(pkt);
+    }
+  }, 200);
+
+  outArm.setMode(lastMode);
+  Serial.println(F("Done"));
 }
 
+#endif
+
+#ifdef SERVO_ENGINE_HZ
+// ==============================================================
+// Servo engine interrupt: ends each pulse and starts each frame
+//
+ISR(TIMER1_COMPB_vect) {
+  servoEngine.service();
+}
+#endif
 
 // ==============================================================
 // Voltage reading function
@@ -3,13 +3,19 @@
 
 #include <Servo.h>
 #include "mimic.h"
+#include "Predictor.h"
+#include "ServoEngine.h"
 
 
-enum UpdateMode : unsigned { Immediate, Increment1, IncrementHalf, IncrementTime };
+enum UpdateMode : unsigned { Immediate, Increment1, IncrementHalf, IncrementTime, Predict };
+
+// The joints are numbered in this order when the ServoEngine is used
+enum Joint : uint8_t { PinchJoint, WristJoint, ElbowJoint, WaistJoint };
 
 class OutputArm : public Arm {
 private:
   UpdateMode mode;
+  ServoEngine *engine;
 
 public:
 
@@ -18,6 +24,10 @@ public:
   float pinchInc, wristInc, elbowInc, waistInc;
   float pinchPos, wristPos, elbowPos, waistPos;
   uint32_t lastUpdate;
+  AlphaBeta pinchFilter, wristFilter, elbowFilter, waistFilter;
+  FilterGains gains;
+  uint32_t lastSample;
+  unsigned long (*clock)(void);   // microsecond time source for the filters, micros() by default
 
   OutputArm(void) = delete;
 
@@ -29,6 +39,7 @@ public:
     pinMode(waistPin, OUTPUT);
 
     mode = Immediate;
+    engine = nullptr;
 
     pinchPos = target.pinch = pinch = range.a.pinch;  // set pincher to wide open, not the midpoint like the others
     wristPos = target.wrist = wrist = ((range.b.wrist - range.a.wrist) / 2) + range.a.wrist;
@@ -37,11 +48,37 @@ public:
 
     pinchInc = wristInc = elbowInc = waistInc = 1.0f;
     lastUpdate = micros();
+
+    clock = micros;
+    resetFilters();
+  }
+
+  // Drive the servos from a running ServoEngine instead of the Servo
+  // library so all four joints are updated in the same frame.
+  // Pass nullptr to go back to the Servo library
+  //
+  void useEngine(ServoEngine *e) {
+    detach();
+    engine = e;
+    if (engine != nullptr) {
+      engine->write(PinchJoint, last.pinch = pinch);
+      engine->write(WristJoint, last.wrist = wrist);
+      engine->write(ElbowJoint, last.elbow = elbow);
+      engine->write(WaistJoint, last.waist = waist);
+    }
   }
 
   // Attach the output pins to their servos
   // 
   void attach(void) {
+    if (engine != nullptr) {
+      engine->attach(PinchJoint, pinchPin);
+      engine->attach(WristJoint, wristPin);
+      engine->attach(ElbowJoint, elbowPin);
+      engine->attach(WaistJoint, waistPin);
+      engine->commit();
+      return;
+    }
     pinchServo.attach(pinchPin);
     wristServo.attach(wristPin);
     elbowServo.attach(elbowPin);
@@ -51,6 +88,14 @@ public:
   // Detach the output pins from their servos 
   // 
   void detach(void) {
+    if (engine != nullptr) {
+      engine->detach(PinchJoint);
+      engine->detach(WristJoint);
+      engine->detach(ElbowJoint);
+      engine->detach(WaistJoint);
+      engine->commit();
+      return;
+    }
     pinchServo.detach();
     wristServo.detach();
     elbowServo.detach();
@@ -63,6 +108,22 @@ public:
     target.wrist = map(arm.wrist, arm.range.a.wrist, arm.range.b.wrist, range.a.wrist, range.b.wrist);
     target.elbow = map(arm.elbow, arm.range.a.elbow, arm.range.b.elbow, range.a.elbow, range.b.elbow);
     target.waist = map(arm.waist, arm.range.a.waist, arm.range.b.waist, range.a.waist, range.b.waist);
+
+    if (mode == Predict) {
+      // each mapped reading is a new measurement for the filters.
+      // the timed move increments are not used so skip the float math
+      // (a gap of over 36 minutes would go negative as an int32_t)
+      uint32_t now = clock();
+      uint32_t since = now - lastSample;
+      int32_t dt = (since > (uint32_t) PREDICT_STALE_US) ? PREDICT_STALE_US + 1 : (int32_t) since;
+      lastSample = now;
+      pinchFilter.update(target.pinch, dt, gains);
+      wristFilter.update(target.wrist, dt, gains);
+      elbowFilter.update(target.elbow, dt, gains);
+      waistFilter.update(target.waist, dt, gains);
+      return *this;
+    }
+
     calcIncs();
     pinchInc = wristInc = elbowInc = waistInc = 1.0f;
     return *this;
@@ -72,6 +133,9 @@ public:
   //
   OutputArm & operator = (Pos &pos) {
     target = pos;
+    if (mode == Predict) {
+      resetFilters();
+    }
     calcIncs();
     pinchInc = wristInc = elbowInc = waistInc = 1.0f;
     return *this;
@@ -81,9 +145,25 @@ public:
   //
   void setMode(UpdateMode m) {
     mode = m;
+    resetFilters();
     calcIncs();
   }
 
+  UpdateMode getMode() const {
+    return mode;
+  }
+
+  // Restart the predictive filters at the current target
+  // so there is no stale velocity left over
+  //
+  void resetFilters(void) {
+    pinchFilter.reset(target.pinch);
+    wristFilter.reset(target.wrist);
+    elbowFilter.reset(target.elbow);
+    waistFilter.reset(target.waist);
+    lastSample = clock();
+  }
+
   // Pause for the specified number of milliseconds,
   // continually updating the output position if necessary
   //
@@ -116,6 +196,9 @@ public:
 
   void write(Pos &pos, int ms = 0, bool wait = false) {
     target = pos;
+    if (mode == Predict) {
+      resetFilters();
+    }
 
     calcIncs();
 
@@ -126,6 +209,32 @@ public:
   }
 
 
+  // Move one joint straight to a position.  The target and the joint's
+  // filter go with it so the update mode doesn't pull it back
+  //
+  void writeJoint(Joint joint, int value) {
+    switch (joint) {
+      case PinchJoint:
+        pinch = target.pinch = value;
+        pinchFilter.reset(value);
+        break;
+      case WristJoint:
+        wrist = target.wrist = value;
+        wristFilter.reset(value);
+        break;
+      case ElbowJoint:
+        elbow = target.elbow = value;
+        elbowFilter.reset(value);
+        break;
+      case WaistJoint:
+        waist = target.waist = value;
+        waistFilter.reset(value);
+        break;
+    }
+    write();
+  }
+
+
   // Update the servos towards the target position
   // using the current update mode
   void write(void) {
@@ -167,6 +276,51 @@ public:
           waist = clip(waist, range.a.waist, range.b.waist);
         }
         break;
+
+      case Predict:
+        {
+          // extrapolate past the last reading by the time since it was
+          // taken plus the lead time to make up for the servo lag.
+          // Once the readings have stopped, hold the last ones instead
+          uint32_t since = clock() - lastSample;
+          if (since > (uint32_t) PREDICT_STALE_US) {
+            resetFilters();
+            since = 0;
+          }
+          int32_t ahead = (int32_t) since + gains.lead * 1000L;
+
+          pinch = clip(pinchFilter.predict(ahead), range.a.pinch, range.b.pinch);
+          wrist = clip(wristFilter.predict(ahead), range.a.wrist, range.b.wrist);
+          elbow = clip(elbowFilter.predict(ahead), range.a.elbow, range.b.elbow);
+          waist = clip(waistFilter.predict(ahead), range.a.waist, range.b.waist);
+        }
+        break;
+    }
+
+    if (engine != nullptr) {
+      // stage all of the changes and commit them together
+      // so they take effect in the same frame
+      bool changed = false;
+      if (last.pinch != pinch) {
+        engine->write(PinchJoint, last.pinch = pinch);
+        changed = true;
+      }
+      if (last.wrist != wrist) {
+        engine->write(WristJoint, last.wrist = wrist);
+        changed = true;
+      }
+      if (last.elbow != elbow) {
+        engine->write(ElbowJoint, last.elbow = elbow);
+        changed = true;
+      }
+      if (last.waist != waist) {
+        engine->write(WaistJoint, last.waist = waist);
+        changed = true;
+      }
+      if (changed) {
+        engine->commit();
+      }
+      return;
     }
 
     if (last.pinch != pinch) {
@@ -196,12 +350,14 @@ public:
     parkMoves.addTail(Pos(1050, 2300,  450,  620));
 
     Node<Pos> *ptr;
+    UpdateMode lastMode = mode;
     mode = Immediate;
     attach();
     for (ptr = parkMoves.head; ptr != nullptr; ptr = ptr->next) {
       *this = ptr->t;
       delay(1000);
     }
+    setMode(lastMode);
   }
   
 };
@@ -0,0 +1,111 @@
+#ifndef PREDICTOR_H_INCL
+#define PREDICTOR_H_INCL
+
+#include "mimic.h"
+
+// Default tuning for the predictive filter.
+// The gains are fixed point fractions of 256 (256 == 1.0)
+#define DEFAULT_ALPHA     128   // 0.50 - how much of each new reading is trusted
+#define DEFAULT_BETA       32   // 0.125 - how quickly the velocity estimate reacts
+#define DEFAULT_LEAD       12   // milliseconds to extrapolate ahead to cancel servo and loop lag
+#define DEFAULT_DEADBAND    6   // once the hand is still, readings this close (in servo microseconds) to the prediction are noise
+
+// If the filter has not seen a reading for this many microseconds
+// (idle mode, playback, parking) it stops extrapolating and
+// restarts from the next reading
+#define PREDICT_STALE_US  65000L
+
+// The hand counts as still once its readings have stayed inside the
+// deadband of where it last moved to for this many microseconds
+#define PREDICT_STILL_US  40000L
+
+// Velocity clamp (Q8 microseconds per tick). No servo moves faster than
+// this and it keeps the 32-bit math from overflowing
+#define PREDICT_MAX_VEL   32000L
+
+
+// The FilterGains structure holds the tunable values shared
+// by all of the joint filters
+//
+struct FilterGains {
+  uint16_t alpha, beta, lead, deadband;
+
+  FilterGains() :
+    alpha(DEFAULT_ALPHA),
+    beta(DEFAULT_BETA),
+    lead(DEFAULT_LEAD),
+    deadband(DEFAULT_DEADBAND) {
+  }
+};
+
+
+// The AlphaBeta structure is a fixed point alpha-beta filter for one joint.
+// It tracks a position and a velocity estimate so the output can be
+// extrapolated slightly into the future.
+//
+//   x := position in Q8 servo microseconds
+//   v := velocity in Q8 servo microseconds per 1024 uS "tick"
+//
+struct AlphaBeta {
+  int32_t x, v;
+  int16_t anchor;       // the reading the hand last moved to
+  int32_t still;        // microseconds the readings have stayed near 'anchor'
+
+  AlphaBeta() : x(0), v(0), anchor(0), still(0) {
+  }
+
+  void reset(int value) {
+    x = (int32_t) value << 8;
+    v = 0;
+    anchor = value;
+    still = 0;
+  }
+
+  // Fold a new reading (in servo microseconds) taken dt microseconds
+  // after the previous one into the estimate
+  //
+  void update(int value, int32_t dt, FilterGains &gains) {
+    if (dt > PREDICT_STALE_US) {
+      reset(value);
+      return;
+    }
+    if (dt < 1)
+      dt = 1;
+
+    int32_t predicted = x + ((v * dt) >> 10);
+    int32_t residual = ((int32_t) value << 8) - predicted;
+
+    // Stillness is judged on the readings themselves, not on the
+    // prediction, so a slow steady move never looks like a still hand
+    if (abs(value - anchor) > (int) gains.deadband) {
+      anchor = value;
+      still = 0;
+    } else if (still < PREDICT_STILL_US) {
+      still += dt;
+    }
+
+    // Once the hand is still, readings this close to the prediction are
+    // only noise: coast on the prediction and bleed off the velocity so
+    // the output settles.  A moving hand always gets the full update
+    if (still >= PREDICT_STILL_US && labs(residual) <= ((int32_t) gains.deadband << 8)) {
+      x = predicted;
+      v = (v * 3) / 4;
+      return;
+    }
+
+    x = predicted + ((gains.alpha * residual) >> 8);
+    v += (((gains.beta * residual) >> 8) * 1024) / dt;
+    v = constrain(v, -PREDICT_MAX_VEL, PREDICT_MAX_VEL);
+  }
+
+  // Return the estimated position (in servo microseconds)
+  // the specified number of microseconds past the last reading.
+  // Clamping 'ahead' keeps v * ahead inside 32 bits
+  //
+  int predict(int32_t ahead) const {
+    ahead = constrain(ahead, 0L, PREDICT_STALE_US);
+    return (int) ((x + ((v * ahead) >> 10) + 128) >> 8);
+  }
+};
+
+#endif // #ifndef PREDICTOR_H_INCL
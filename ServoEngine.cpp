@@ -0,0 +1,283 @@
+// ====================================================================================================
+//
+// ServoEngine - frame synchronized servo pulse generator using Timer1
+//
+
+#include <Arduino.h>
+#include "ServoEngine.h"
+
+// The engine needs Timer1 with a compare B channel (ATmega328, ATmega2560, ATmega32U4, etc.)
+#if defined(TCCR1B) && defined(OCR1B) && defined(OCIE1B)
+#define ENGINE_TIMER1
+#endif
+
+
+ServoEngine::ServoEngine() :
+  active(0),
+  pending(false),
+  attached(0),
+  period(0),
+  ticksPerUs(0),
+  running(false),
+  nextPeriodTicks(0),
+  nextGapTicks(0),
+  nextPrescale(0),
+  rateDue(false),
+  periodTicks(0),
+  gapTicks(0),
+  frameStart(0),
+  edge(0),
+  high(false),
+  frameCount(0),
+  commitCount(0) {
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    width[i] = ENGINE_DEFAULT_US;
+    port[i] = nullptr;
+    mask[i] = 0;
+  }
+  frame[0].count = frame[1].count = 0;
+}
+
+
+// ====================================================================================================
+// Start generating frames at the specified rate.
+// Timer1 runs free with no prescaler when the whole frame fits in its 16 bits
+// (62.5 nS resolution at 16 MHz), otherwise with a prescaler of 8 (0.5 uS).
+// A running engine hands the new rate to the interrupt along with a set of
+// widths converted to the new timer ticks, and both start at the next frame
+// boundary, so no pulse is cut short.
+//
+void ServoEngine::begin(uint16_t hz) {
+#ifdef ENGINE_TIMER1
+  hz = constrain(hz, ENGINE_MIN_HZ, ENGINE_MAX_HZ);
+
+  uint8_t prescale = _BV(CS10);
+  uint8_t ticks = clockCyclesPerMicrosecond();
+  uint16_t us = 1000000UL / hz;
+  if ((uint32_t) us * ticks > 0xFFFFUL) {
+    prescale = _BV(CS11);
+    ticks /= 8;
+  }
+
+  // keep the interrupt from taking the current set of widths with the
+  // new rate before they have been converted to the new timer ticks
+  uint8_t sreg = SREG;
+  cli();
+  pending = false;
+  period = us;
+  ticksPerUs = ticks;
+  nextPeriodTicks = us * ticks;
+  nextGapTicks = ENGINE_GAP_US * ticks;
+  nextPrescale = prescale;
+  rateDue = running;
+  SREG = sreg;
+
+  // re-stage the widths so they are clipped to the new frame length
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    write(i, width[i]);
+  }
+  commit();
+
+  if (running)
+    return;
+
+  sreg = SREG;
+  cli();
+  TCCR1A = 0;
+  TCCR1B = prescale;
+  periodTicks = nextPeriodTicks;
+  gapTicks = nextGapTicks;
+  high = false;
+  edge = 0;
+  OCR1B = TCNT1 + periodTicks;
+  TIFR1 = _BV(OCF1B);
+  TIMSK1 = (TIMSK1 & ~_BV(OCIE1A)) | _BV(OCIE1B);
+  SREG = sreg;
+
+  running = true;
+#else
+  (void) hz;
+#endif
+}
+
+
+// ====================================================================================================
+// Stop generating frames and leave all of the pins low
+//
+void ServoEngine::end(void) {
+#ifdef ENGINE_TIMER1
+  if (!running)
+    return;
+
+  uint8_t sreg = SREG;
+  cli();
+  TIMSK1 &= ~_BV(OCIE1B);
+  rateDue = false;
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    if (port[i] != nullptr) {
+      *port[i] &= ~mask[i];
+    }
+  }
+  SREG = sreg;
+
+  running = false;
+#endif
+}
+
+
+// ====================================================================================================
+// Attach or detach a joint's output pin.  Takes effect on the next commit()
+//
+void ServoEngine::attach(uint8_t joint, uint8_t pin) {
+  if (joint >= ENGINE_JOINTS)
+    return;
+
+  digitalWrite(pin, LOW);
+  pinMode(pin, OUTPUT);
+
+  // the pin can change while the joint is still in the frame being played
+  uint8_t sreg = SREG;
+  cli();
+  port[joint] = portOutputRegister(digitalPinToPort(pin));
+  mask[joint] = digitalPinToBitMask(pin);
+  SREG = sreg;
+
+  attached |= _BV(joint);
+}
+
+void ServoEngine::detach(uint8_t joint) {
+  if (joint >= ENGINE_JOINTS)
+    return;
+
+  attached &= ~_BV(joint);
+}
+
+
+// ====================================================================================================
+// Stage a pulse width in microseconds for a joint.  Takes effect on the next commit()
+//
+void ServoEngine::write(uint8_t joint, uint16_t us) {
+  if (joint >= ENGINE_JOINTS)
+    return;
+
+  uint16_t longest = ENGINE_MAX_US;
+  if (period != 0 && period - ENGINE_TAIL_US < longest)
+    longest = period - ENGINE_TAIL_US;
+
+  width[joint] = constrain(us, ENGINE_MIN_US, longest);
+}
+
+
+// ====================================================================================================
+// Build the next frame from the staged widths and hand it to the interrupt.
+// Clearing 'pending' first keeps the interrupt from swapping to the spare
+// buffer while we fill it.  A later commit() before the next frame boundary
+// simply replaces this one.  frame[] isn't volatile so the compiler barriers
+// keep its stores between the two writes to 'pending'.
+//
+void ServoEngine::commit(void) {
+  pending = false;
+  asm volatile("" ::: "memory");
+
+  EngineFrame &f = frame[active ^ 1];
+  f.count = 0;
+  for (uint8_t j=0; j < ENGINE_JOINTS; j++) {
+    if (!(attached & _BV(j)))
+      continue;
+
+    // insertion sort by width
+    uint16_t ticks = width[j] * ticksPerUs;
+    uint8_t i = f.count++;
+    while (i > 0 && f.ticks[i - 1] > ticks) {
+      f.ticks[i] = f.ticks[i - 1];
+      f.joint[i] = f.joint[i - 1];
+      i--;
+    }
+    f.ticks[i] = ticks;
+    f.joint[i] = j;
+  }
+
+  asm volatile("" ::: "memory");
+  pending = true;
+}
+
+
+// ====================================================================================================
+// Frame counters
+//
+uint32_t ServoEngine::frames(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t result = frameCount;
+  SREG = sreg;
+  return result;
+}
+
+uint32_t ServoEngine::commits(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t result = commitCount;
+  SREG = sreg;
+  return result;
+}
+
+
+// ====================================================================================================
+// Called from the Timer1 compare B interrupt at the start of each frame and
+// at the end of each pulse.  OCR1B is always advanced from the scheduled time,
+// not from TCNT1, so interrupt latency never stretches the frame.
+// Times are compared as ticks since the frame started, which never wraps
+// since a whole frame fits in the 16 bit timer.
+//
+void ServoEngine::service(void) {
+#ifdef ENGINE_TIMER1
+  if (!high) {
+    // frame boundary: pick up a committed set of widths and start every pulse
+    frameStart = OCR1B;
+    if (pending) {
+      active ^= 1;
+      pending = false;
+      commitCount++;
+
+      // the set was built for a new frame rate: switch the timer over and
+      // time the frame from here in the new ticks
+      if (rateDue) {
+        TCCR1B = nextPrescale;
+        periodTicks = nextPeriodTicks;
+        gapTicks = nextGapTicks;
+        frameStart = TCNT1;
+        rateDue = false;
+      }
+    }
+    frameCount++;
+
+    const EngineFrame &f = frame[active];
+    for (uint8_t i=0; i < f.count; i++) {
+      *port[f.joint[i]] |= mask[f.joint[i]];
+    }
+    high = true;
+    edge = 0;
+  }
+
+  // end every pulse that is due, waiting out any that are due
+  // too soon to be worth leaving the interrupt for
+  const EngineFrame &f = frame[active];
+  while (edge < f.count) {
+    uint16_t due = f.ticks[edge];
+    uint16_t elapsed = TCNT1 - frameStart;
+    if (due > elapsed && due - elapsed > gapTicks)
+      break;
+    while ((uint16_t) (TCNT1 - frameStart) < due)
+      ;
+    *port[f.joint[edge]] &= ~mask[f.joint[edge]];
+    edge++;
+  }
+
+  if (edge < f.count) {
+    OCR1B = frameStart + f.ticks[edge];
+  } else {
+    OCR1B = frameStart + periodTicks;
+    high = false;
+  }
+#endif
+}
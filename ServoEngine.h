@@ -0,0 +1,112 @@
+// ====================================================================================================
+//
+// ServoEngine - frame synchronized servo pulse generator using Timer1
+//
+// All of the attached servo pulses start together at the beginning of each frame
+// and each one ends from the same Timer1 compare B interrupt, shortest first.
+// New pulse widths are staged and then committed as one set.  A committed set is
+// only picked up at the next frame boundary so a multi-joint move always takes
+// effect in a single frame.
+//
+// Compare A is left to the Servo library (which this replaces when it is running)
+// so both can be linked into the same sketch.  Don't attach Servo objects while
+// the engine is running, they both want Timer1.  Starting the engine turns off
+// the compare A interrupt since the Servo library's handler resets TCNT1.
+//
+// The sketch owns the engine instance and the TIMER1_COMPB_vect interrupt that
+// calls its service(), so neither costs anything unless the engine is used.
+//
+
+#ifndef SERVO_ENGINE_INCL
+#define SERVO_ENGINE_INCL
+
+#include <Arduino.h>
+
+#define ENGINE_JOINTS       4
+
+#define ENGINE_MIN_HZ      50           // 20 ms frame - analog servos
+#define ENGINE_MAX_HZ     333           // 3 ms frame - fast digital servos
+
+#define ENGINE_MIN_US     400           // narrowest pulse allowed
+#define ENGINE_MAX_US    2600           // widest pulse allowed (also limited by the frame)
+#define ENGINE_DEFAULT_US 1500
+
+#define ENGINE_GAP_US      16           // pulses ending this close together are ended in the same interrupt
+#define ENGINE_TAIL_US    200           // minimum low time at the end of each frame
+
+
+// The EngineFrame structure is one complete set of pulses for a frame,
+// pre-sorted by width so the interrupt only has to walk it in order
+//
+struct EngineFrame {
+  uint8_t count;                    // number of attached joints in the frame
+  uint8_t joint[ENGINE_JOINTS];     // joints in order of increasing pulse width
+  uint16_t ticks[ENGINE_JOINTS];    // matching pulse widths in timer ticks
+};
+
+
+class ServoEngine {
+protected:
+  EngineFrame frame[2];             // double buffered: the ISR plays frame[active]
+  volatile uint8_t active;
+  volatile bool pending;            // frame[active ^ 1] is complete and waiting for a boundary
+
+  uint16_t width[ENGINE_JOINTS];    // staged pulse widths in microseconds
+  uint8_t attached;                 // bit mask of attached joints
+  volatile uint8_t *port[ENGINE_JOINTS];
+  uint8_t mask[ENGINE_JOINTS];
+
+  uint16_t period;                  // frame length in microseconds
+  uint8_t ticksPerUs;
+  bool running;
+
+  // a new frame rate waiting for the interrupt to pick it up at a frame boundary
+  uint16_t nextPeriodTicks, nextGapTicks;
+  uint8_t nextPrescale;
+  volatile bool rateDue;
+
+  // interrupt state
+  uint16_t periodTicks, gapTicks;
+  uint16_t frameStart;
+  uint8_t edge;
+  bool high;
+  volatile uint32_t frameCount, commitCount;
+
+public:
+  ServoEngine();
+
+  // Start generating frames at the specified rate (ENGINE_MIN_HZ - ENGINE_MAX_HZ).
+  // If the engine is already running the new rate starts at the next frame boundary
+  void begin(uint16_t hz);
+
+  // Stop generating frames and leave all of the pins low
+  void end(void);
+
+  bool isRunning(void) const {
+    return running;
+  }
+
+  uint16_t framePeriod(void) const {
+    return period;
+  }
+
+  // Attach or detach a joint's output pin.  Takes effect on the next commit()
+  void attach(uint8_t joint, uint8_t pin);
+  void detach(uint8_t joint);
+
+  // Stage a pulse width in microseconds for a joint.  Takes effect on the next commit()
+  void write(uint8_t joint, uint16_t us);
+
+  // Hand the staged widths to the interrupt as one set to be
+  // used starting at the next frame boundary
+  void commit(void);
+
+  // Number of frames generated, and number of frames that picked up a new set of widths
+  uint32_t frames(void);
+  uint32_t commits(void);
+
+  // Called from the Timer1 compare B interrupt
+  void service(void);
+};
+
+#endif // #ifndef SERVO_ENGINE_INCL
@@ -0,0 +1,471 @@
+#ifndef TRACE_H_INCL
+#define TRACE_H_INCL
+
+#include "mimic.h"
+#include "Predictor.h"
+
+// Number of events held in the ring (6 bytes each).  When it is full
+// the oldest events are overwritten, so a recording holds the
+// latest stretch of the session up to when it is stopped
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS      64
+#endif
+
+// A keyframe of the whole control state is taken after this many events.
+// Enough keyframes are kept that the oldest one is always in the ring
+#define TRACE_KEY_EVENTS  16
+#define TRACE_KEYS        (TRACE_EVENTS / TRACE_KEY_EVENTS + 1)
+
+// Only record an input arm sample this often (in milliseconds)
+// and only if it changed, so the ring isn't flooded by the mimic loop
+#define TRACE_INPUT_MS    20
+
+// Largest change in a pot reading one input event holds.
+// Bigger changes are split over several events
+#define TRACE_STEP        127
+
+// A replayed servo position further than this (in microseconds) from
+// the one in a keyframe counts as a mismatch.  The filters only see the
+// recorded samples in a replay, so it trails the live session by about
+// as far as the hand moves in TRACE_INPUT_MS
+#define TRACE_TOLERANCE   100
+
+// How long to wait for each byte when a trace is uploaded
+#define TRACE_LOAD_MS     250
+
+enum TraceType : uint8_t { TRACE_WAIT, TRACE_INPUT, TRACE_INPUT_PART, TRACE_BUTTON, TRACE_COMMAND };
+enum TraceState : uint8_t { TRACE_OFF, TRACE_RECORD, TRACE_REPLAY };
+
+
+// The TraceEvent structure is one timed entry in a trace.
+// It is dumped and loaded as raw bytes so keep it fixed size.
+// Multi-byte values are stored low byte first:
+//
+//   TRACE_WAIT        data[0..1] = milliseconds before the next event (for gaps over 255 mS)
+//   TRACE_INPUT       data[]     = change in the pinch, wrist, elbow, waist pot readings (int8_t)
+//   TRACE_INPUT_PART  the same, for a change too big for one event.  The rest follows it
+//   TRACE_BUTTON      data[0]    = button pin level
+//   TRACE_COMMAND     data[0]    = command byte, data[1..2] = command value
+//
+struct TraceEvent {
+  uint8_t delta;      // milliseconds since the previous event
+  uint8_t type;
+  uint8_t data[4];
+};
+
+
+// The TraceKey structure is a keyframe: the control state at the start of
+// a loop pass, before event number 'at'.  A replay starts from the oldest
+// keyframe left in the ring and checks its servo positions against the
+// later ones
+//
+struct TraceKey {
+  uint16_t at;        // number of the event that follows the keyframe
+  Pos input;          // the last input sample (the base for the input events that follow)
+  Pos output;         // servo positions
+  uint8_t mode;       // app mode
+  uint8_t update;     // output arm update mode
+  uint8_t level;      // button pin level
+  FilterGains gains;
+};
+
+
+// The Trace class records input samples, button edges and serial commands
+// in a ring, with keyframes of the control state, and can play them back
+// in order with the same timing.  Input and button events are applied by
+// the trace itself; command events are handed back to the caller.
+//
+// Recording only watches the control loop, which runs as usual.  A replay
+// keeps its own clock, the sum of the recorded event times, and feeds the
+// control loop only the recorded samples, so every replay of a trace
+// produces exactly the same outputs.  They follow the live session to
+// within the sampling of the trace, which is what TRACE_TOLERANCE allows for.
+//
+class Trace {
+protected:
+  TraceEvent events[TRACE_EVENTS];
+  TraceKey keys[TRACE_KEYS];
+  uint8_t head, count;          // the oldest event in the ring and the number held
+  uint8_t keyHead, keyCount;
+  uint16_t total;               // events ever recorded: the number of the next one
+  uint16_t cursor;              // replay: number of the next event
+  uint8_t nextKey;              // replay: the next keyframe to check (keys[] index)
+  uint8_t sinceKey;             // recording: events since the last keyframe
+  uint32_t lastTime, lastInput, clock;
+  bool fresh;
+  uint8_t done;
+
+  static uint16_t gap(TraceEvent &ev) {
+    return (ev.type == TRACE_WAIT) ? ev.data[0] | (ev.data[1] << 8) : ev.delta;
+  }
+
+  // The event or keyframe with the specified number or position
+  //
+  TraceEvent &event(uint16_t number) {
+    return events[(head + (uint16_t) (number - (total - count))) % TRACE_EVENTS];
+  }
+
+  TraceKey &key(uint8_t n) {
+    return keys[(keyHead + n) % TRACE_KEYS];
+  }
+
+  // True if the numbered event is still in the ring
+  //
+  bool held(uint16_t number) const {
+    return (uint16_t) (total - number) <= count;
+  }
+
+  // Stop recording or replaying and remember which one it was for finished()
+  //
+  void stop() {
+    done = state;
+    state = TRACE_OFF;
+  }
+
+  // Append an event to the ring, overwriting the oldest one when it's full
+  //
+  TraceEvent &push(uint8_t type, uint8_t delta) {
+    if (count == TRACE_EVENTS) {
+      head = (head + 1) % TRACE_EVENTS;
+      count--;
+    }
+    TraceEvent &ev = events[(head + count) % TRACE_EVENTS];
+    count++;
+    total++;
+    if (sinceKey < 0xFF)
+      sinceKey++;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.delta = delta;
+    ev.type = type;
+    return ev;
+  }
+
+  // Append an event timed from the previous one.
+  // Returns nullptr when not recording
+  //
+  TraceEvent *add(uint8_t type) {
+    if (state != TRACE_RECORD)
+      return nullptr;
+
+    uint32_t now = millis();
+    uint32_t delta = now - lastTime;
+    lastTime = now;
+
+    if (delta > 0xFF) {
+      if (delta > 0xFFFF)
+        delta = 0xFFFF;
+      TraceEvent &wait = push(TRACE_WAIT, 0);
+      wait.data[0] = delta & 0xFF;
+      wait.data[1] = delta >> 8;
+      delta = 0;
+    }
+    return &push(type, delta);
+  }
+
+  // Read one byte, giving up after TRACE_LOAD_MS
+  //
+  static bool readByte(Stream &port, uint8_t &b) {
+    uint32_t timer = millis() + TRACE_LOAD_MS;
+    while (port.available() == 0) {
+      if (millis() >= timer)
+        return false;
+    }
+    b = port.read();
+    return true;
+  }
+
+  static bool readBytes(Stream &port, void *data, unsigned size) {
+    for (unsigned b=0; b < size; b++) {
+      if (!readByte(port, ((uint8_t *) data)[b]))
+        return false;
+    }
+    return true;
+  }
+
+public:
+  uint8_t state;
+  uint8_t level;        // button pin level (recorded or replayed)
+  uint16_t mismatches;  // replayed keyframes whose servo positions differ from the recording
+  uint16_t worst;       // largest difference seen in a replayed keyframe (microseconds)
+  Pos input;            // the last input sample (recorded or replayed)
+
+  Trace() : head(0), count(0), keyHead(0), keyCount(0), total(0), cursor(0), nextKey(0), sinceKey(0),
+    lastTime(0), lastInput(0), clock(0), fresh(false), done(TRACE_OFF),
+    state(TRACE_OFF), level(HIGH), mismatches(0), worst(0) {
+  }
+
+  // The trace clock in milliseconds
+  //
+  uint32_t now() const {
+    return clock;
+  }
+
+  // True while the control loop should take its time from now().
+  // This stays true after a replay ends until finished() is called
+  //
+  bool timed() const {
+    return state == TRACE_REPLAY || done == TRACE_REPLAY;
+  }
+
+  // Begin recording (discarding the last trace), begin replaying the trace
+  // from its oldest keyframe, or stop either one.  A recording needs its
+  // first keyframe (see keyframe()) and a replay must be set up from start()
+  //
+  void begin(uint8_t s) {
+    state = s;
+    mismatches = worst = 0;
+    clock = 0;
+    lastTime = lastInput = millis();
+    fresh = false;
+    done = TRACE_OFF;
+
+    if (s == TRACE_RECORD) {
+      head = count = keyHead = keyCount = 0;
+      total = 0;
+      return;
+    }
+
+    if (s == TRACE_REPLAY) {
+      // drop the keyframes whose events have been overwritten
+      while (keyCount > 0 && !held(key(0).at)) {
+        keyHead = (keyHead + 1) % TRACE_KEYS;
+        keyCount--;
+      }
+      if (keyCount == 0) {
+        state = TRACE_OFF;
+        return;
+      }
+      cursor = key(0).at;
+      nextKey = 1;
+      input = key(0).input;
+      level = key(0).level;
+    }
+  }
+
+  // The keyframe a replay starts from
+  //
+  TraceKey &start() {
+    return key(0);
+  }
+
+  // Recording: true when the next keyframe is due
+  //
+  bool keyDue() const {
+    return state == TRACE_RECORD && (keyCount == 0 || sinceKey >= TRACE_KEY_EVENTS);
+  }
+
+  // Recording: store a keyframe of the control state filled in by the
+  // caller.  Its input becomes the base for the following input events
+  //
+  void keyframe(TraceKey &k) {
+    if (keyCount == TRACE_KEYS) {
+      keyHead = (keyHead + 1) % TRACE_KEYS;
+      keyCount--;
+    }
+    TraceKey &dest = key(keyCount++);
+    dest = k;
+    dest.at = total;
+    input = k.input;
+    sinceKey = 0;
+  }
+
+  // Replay: true when the replay has reached the next keyframe.
+  // The caller checks its outputs with checkKey()
+  //
+  bool keyReached() {
+    return state == TRACE_REPLAY && nextKey < keyCount && cursor == key(nextKey).at;
+  }
+
+  // Replay: compare the servo positions against the next keyframe's
+  //
+  void checkKey(Pos &pos) {
+    TraceKey &k = key(nextKey++);
+    int diff = max(max(abs((int) pos.pinch - (int) k.output.pinch), abs((int) pos.wrist - (int) k.output.wrist)),
+                   max(abs((int) pos.elbow - (int) k.output.elbow), abs((int) pos.waist - (int) k.output.waist)));
+    if (diff > TRACE_TOLERANCE)
+      mismatches++;
+    if (diff > (int) worst)
+      worst = diff;
+  }
+
+  // Called by the control loop with each input arm reading.
+  // Recording: the reading is recorded as a sample if one is due and it changed.
+  // Replaying: the reading is ignored, the next recorded sample is used when it's due.
+  // Returns true when 'input' holds a new sample
+  //
+  bool sample(Pos &reading) {
+    if (state == TRACE_REPLAY) {
+      bool result = fresh;
+      fresh = false;
+      return result;
+    }
+    if (state != TRACE_RECORD || millis() - lastInput < TRACE_INPUT_MS)
+      return false;
+
+    int change[4] = {
+      (int) reading.pinch - (int) input.pinch,
+      (int) reading.wrist - (int) input.wrist,
+      (int) reading.elbow - (int) input.elbow,
+      (int) reading.waist - (int) input.waist
+    };
+    int largest = 0;
+    for (uint8_t j=0; j < 4; j++)
+      largest = max(largest, abs(change[j]));
+    if (largest == 0)
+      return false;
+
+    lastInput = millis();
+    for (uint8_t parts = (largest + TRACE_STEP - 1) / TRACE_STEP; parts > 0; parts--) {
+      TraceEvent *ev = add(parts > 1 ? TRACE_INPUT_PART : TRACE_INPUT);
+      for (uint8_t j=0; j < 4; j++) {
+        int step = constrain(change[j], -TRACE_STEP, TRACE_STEP);
+        ev->data[j] = (uint8_t) (int8_t) step;
+        change[j] -= step;
+      }
+    }
+
+    input = reading;
+    return true;
+  }
+
+  void recordButton(int pinLevel) {
+    if (state == TRACE_RECORD && pinLevel != level) {
+      TraceEvent *ev = add(TRACE_BUTTON);
+      ev->data[0] = pinLevel;
+    }
+    level = pinLevel;
+  }
+
+  void recordCommand(uint8_t cmd, int value) {
+    TraceEvent *ev = add(TRACE_COMMAND);
+    if (ev != nullptr) {
+      ev->data[0] = cmd;
+      ev->data[1] = value & 0xFF;
+      ev->data[2] = (value >> 8) & 0xFF;
+    }
+  }
+
+  // Advance the replay.  Input and button events that are due are applied
+  // here.  If the next due event is a command it is returned (and consumed)
+  // when 'all' is true, otherwise it is left for later.  We stop after each
+  // input sample so the control loop gets to run on it, and at each keyframe
+  // so it can be checked at the start of the next loop pass, where it was taken.
+  // Returns nullptr when nothing (else) is due.
+  //
+  TraceEvent *step(bool all) {
+    while (state == TRACE_REPLAY) {
+      if (keyReached())
+        break;
+      if (cursor == total) {
+        stop();
+        break;
+      }
+
+      TraceEvent &ev = event(cursor);
+      if (millis() - lastTime < gap(ev))
+        break;
+      if (ev.type == TRACE_COMMAND && !all)
+        break;
+
+      lastTime = millis();
+      clock += gap(ev);
+      cursor++;
+
+      switch (ev.type) {
+        case TRACE_COMMAND:
+          return &ev;
+
+        case TRACE_BUTTON:
+          level = ev.data[0];
+          break;
+
+        case TRACE_INPUT:
+        case TRACE_INPUT_PART:
+          input.pinch = input.pinch + (int8_t) ev.data[0];
+          input.wrist = input.wrist + (int8_t) ev.data[1];
+          input.elbow = input.elbow + (int8_t) ev.data[2];
+          input.waist = input.waist + (int8_t) ev.data[3];
+          if (ev.type == TRACE_INPUT) {
+            fresh = true;
+            return nullptr;
+          }
+          break;
+      }
+    }
+    return nullptr;
+  }
+
+  // The command byte and value of a TRACE_COMMAND event
+  //
+  static uint8_t command(TraceEvent &ev) {
+    return ev.data[0];
+  }
+
+  static int commandValue(TraceEvent &ev) {
+    return (int16_t) (ev.data[1] | (ev.data[2] << 8));
+  }
+
+  // Returns TRACE_REPLAY once after a replay has run out of events, otherwise TRACE_OFF
+  //
+  uint8_t finished() {
+    uint8_t result = (done == TRACE_REPLAY) ? TRACE_REPLAY : TRACE_OFF;
+    done = TRACE_OFF;
+    return result;
+  }
+
+  // Send the trace out of the specified port, from its oldest keyframe on:
+  //   'T', keyframe count, event count, sizeof(TraceKey), sizeof(TraceEvent),
+  //   then the raw keyframes (numbered from the first event sent) and the raw events
+  //
+  void dump(Stream &port) {
+    uint8_t first = 0;
+    while (first < keyCount && !held(key(first).at))
+      first++;
+    uint16_t from = (first < keyCount) ? key(first).at : total;
+
+    port.write('T');
+    port.write(keyCount - first);
+    port.write((uint8_t) (total - from));
+    port.write((uint8_t) sizeof(TraceKey));
+    port.write((uint8_t) sizeof(TraceEvent));
+    for (uint8_t k=first; k < keyCount; k++) {
+      TraceKey copy = key(k);
+      copy.at -= from;
+      port.write((uint8_t *) &copy, sizeof(copy));
+    }
+    for (uint16_t n=from; n != total; n++)
+      port.write((uint8_t *) &event(n), sizeof(TraceEvent));
+  }
+
+  // Replace the trace with one read from the specified port in the
+  // format dump() sends, less its 'T'.  Returns false (and leaves the
+  // trace empty) if it doesn't fit or the data stops arriving
+  //
+  bool load(Stream &port) {
+    state = TRACE_OFF;
+    head = count = keyHead = keyCount = 0;
+    total = 0;
+
+    uint8_t header[4];
+    if (!readBytes(port, header, sizeof(header)))
+      return false;
+    if (header[0] == 0 || header[0] > TRACE_KEYS || header[1] > TRACE_EVENTS ||
+        header[2] != sizeof(TraceKey) || header[3] != sizeof(TraceEvent))
+      return false;
+
+    if (!readBytes(port, keys, header[0] * sizeof(TraceKey)) ||
+        !readBytes(port, events, header[1] * sizeof(TraceEvent)))
+      return false;
+    for (uint8_t k=0; k < header[0]; k++) {
+      if (keys[k].at > header[1])
+        return false;
+    }
+
+    keyCount = header[0];
+    count = total = header[1];
+    return true;
+  }
+};
+
+#endif // #ifndef TRACE_H_INCL
@@ -0,0 +1,238 @@
+// ====================================================================================================
+//
+// Host stand-in for the parts of the Arduino core the Mimic sketch uses, so the whole
+// sketch can be built and run on a Linux host for the benchmarks and tests.
+//
+// The pins, pots and registers are plain variables the tests can set and inspect.
+// The clock is the real host clock, or a manual clock that only moves when it is
+// read or delayed so a test runs the same way every time.
+//
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+// pull in the C++ headers before min() and max() become macros
+#include <deque>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F_CPU           16000000UL
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define HIGH            1
+#define LOW             0
+#define DEC             10
+#define HEX             16
+
+#define HOST_PINS       20
+#define A0              14
+#define A1              15
+#define A2              16
+#define A3              17
+
+#define min(a,b)              ((a)<(b)?(a):(b))
+#define max(a,b)              ((a)>(b)?(a):(b))
+#define constrain(x,lo,hi)    ((x)<(lo)?(lo):((x)>(hi)?(hi):(x)))
+
+#define _BV(b)                (1 << (b))
+#define bit_is_set(r,b)       ((r) & _BV(b))
+#define clockCyclesPerMicrosecond()   (F_CPU / 1000000L)
+
+#define PROGMEM
+class __FlashStringHelper;
+#define F(s)                  (reinterpret_cast<const __FlashStringHelper *>(s))
+
+#define ISR(vector)           extern "C" void vector(void)
+#define cli()
+#define sei()
+#define noInterrupts()
+#define interrupts()
+
+// ----------------------------------------------------------------------------------------------------
+// Pins and time
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+extern uint8_t hostPinLevel[HOST_PINS];     // digitalRead()/digitalWrite() levels (HIGH by default)
+extern int hostAnalog[HOST_PINS];           // analogRead() values (512 by default)
+
+// Switch to a manual clock starting at 'us' that advances 'step' microseconds
+// each time it is read, or back to the host clock if 'manual' is false
+void hostClock(bool manual, uint32_t us = 0, uint32_t step = 1);
+void hostAdvance(uint32_t us);
+
+// ----------------------------------------------------------------------------------------------------
+// Registers.  Each pin has its own output "port" with a bit mask of 1.
+// TCNT1 can count by itself (one tick per read) for code that polls it
+
+struct HostTimer16 {
+  uint16_t value;
+  bool autoTick;
+
+  operator uint16_t() {
+    return autoTick ? value++ : value;
+  }
+  HostTimer16 &operator = (uint16_t v) {
+    value = v;
+    return *this;
+  }
+};
+
+extern volatile uint8_t host_ADMUX, host_ADCSRA, host_ADCL, host_ADCH, host_SREG;
+extern volatile uint8_t host_TCCR1A, host_TCCR1B, host_TIMSK1, host_TIFR1;
+extern volatile uint16_t host_OCR1B;
+extern HostTimer16 host_TCNT1;
+extern volatile uint8_t host_PORT[HOST_PINS];
+
+#define ADMUX       host_ADMUX
+#define ADCSRA      host_ADCSRA
+#define ADCL        host_ADCL
+#define ADCH        host_ADCH
+#define SREG        host_SREG
+#define TCCR1A      host_TCCR1A
+#define TCCR1B      host_TCCR1B
+#define TIMSK1      host_TIMSK1
+#define TIFR1       host_TIFR1
+#define TCNT1       host_TCNT1
+#define OCR1B       host_OCR1B
+
+#define REFS0       6
+#define MUX3        3
+#define MUX2        2
+#define MUX1        1
+#define ADSC        6
+#define CS10        0
+#define CS11        1
+#define TOV1        0
+#define OCIE1A      1
+#define OCIE1B      2
+#define OCF1A       1
+#define OCF1B       2
+
+#define digitalPinToPort(pin)       (pin)
+#define digitalPinToBitMask(pin)    ((uint8_t) 1)
+#define portOutputRegister(port)    (&host_PORT[(port)])
+
+// ----------------------------------------------------------------------------------------------------
+// Print and Stream
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size-- > 0)
+      n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char *str) {
+    return write((const uint8_t *) str, strlen(str));
+  }
+
+  size_t print(const char *s)                   { return write(s); }
+  size_t print(const __FlashStringHelper *s)    { return write((const char *) s); }
+  size_t print(char c)                          { return write((uint8_t) c); }
+  size_t print(long n, int base = DEC)          { return number(n < 0, n < 0 ? -(unsigned long) n : n, base); }
+  size_t print(unsigned long n, int base = DEC) { return number(false, n, base); }
+  size_t print(int n, int base = DEC)           { return print((long) n, base); }
+  size_t print(unsigned n, int base = DEC)      { return print((unsigned long) n, base); }
+
+  size_t println(char c)                        { return print(c) + println(); }
+  size_t println(long n, int base = DEC)        { return print(n, base) + println(); }
+  size_t println(unsigned long n, int base = DEC) { return print(n, base) + println(); }
+  size_t println(int n, int base = DEC)         { return print(n, base) + println(); }
+  size_t println(unsigned n, int base = DEC)    { return print(n, base) + println(); }
+  size_t println(const char *s)                 { return print(s) + println(); }
+  size_t println(const __FlashStringHelper *s)  { return print(s) + println(); }
+  size_t println(void)                          { return write("\r\n"); }
+
+private:
+  size_t number(bool negative, unsigned long n, int base) {
+    char buff[24];
+    snprintf(buff, sizeof(buff), base == HEX ? "%s%lX" : "%s%lu", negative ? "-" : "", n);
+    return write(buff);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available(void) = 0;
+  virtual int read(void) = 0;
+  virtual int peek(void) = 0;
+  virtual void flush(void) {}
+};
+
+// A Stream over two byte queues.  The receive side can be pointed at another
+// stream's transmit queue to wire ports together (see connect())
+//
+class HostStream : public Stream {
+protected:
+  std::deque<uint8_t> rxQueue, txQueue;
+
+public:
+  std::deque<uint8_t> *rx, *tx;
+  bool echo;            // send everything written to stdout instead
+
+  HostStream() : rx(&rxQueue), tx(&txQueue), echo(false) {}
+
+  using Print::write;
+  size_t write(uint8_t c) override {
+    if (echo)
+      putchar(c);
+    else
+      tx->push_back(c);
+    return 1;
+  }
+  int available(void) override { return rx->size(); }
+  int read(void) override {
+    if (rx->empty())
+      return -1;
+    int c = rx->front();
+    rx->pop_front();
+    return c;
+  }
+  int peek(void) override { return rx->empty() ? -1 : rx->front(); }
+
+  // receive what 'upstream' writes
+  void connect(HostStream &upstream) { rx = upstream.tx; }
+
+  // queue bytes to be received
+  void inject(const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *) data;
+    rx->insert(rx->end(), p, p + size);
+  }
+};
+
+class HardwareSerial : public HostStream {
+public:
+  HardwareSerial() { echo = true; }
+  void begin(unsigned long baud) { (void) baud; }
+  void end(void) {}
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // #ifndef HOST_ARDUINO_H
@@ -0,0 +1,39 @@
+// ====================================================================================================
+//
+// Host stand-in for the EEPROM library, 1K of RAM that starts out erased (0xFF)
+//
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+#define E2END     0x3FF
+
+class EEPROMClass {
+public:
+  uint8_t data[E2END + 1];
+
+  EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+  uint8_t read(int addr) { return data[addr]; }
+  void write(int addr, uint8_t value) { data[addr] = value; }
+  void update(int addr, uint8_t value) { data[addr] = value; }
+  uint16_t length(void) { return sizeof(data); }
+
+  template <class T>
+  T &get(int addr, T &t) {
+    memcpy(&t, data + addr, sizeof(T));
+    return t;
+  }
+
+  template <class T>
+  const T &put(int addr, const T &t) {
+    memcpy(data + addr, &t, sizeof(T));
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // #ifndef HOST_EEPROM_H
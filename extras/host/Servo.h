@@ -0,0 +1,36 @@
+// ====================================================================================================
+//
+// Host stand-in for the Servo library.  Keeps the last pulse width (per servo and per pin)
+// and counts the writes
+//
+
+#ifndef HOST_SERVO_H
+#define HOST_SERVO_H
+
+#include <Arduino.h>
+
+extern unsigned long hostServoWrites;       // writeMicroseconds() calls by every servo
+extern int hostServoUs[HOST_PINS];          // the last pulse width written to each pin
+
+class Servo {
+public:
+  int pin = -1;
+  int us = 1500;
+
+  uint8_t attach(int p) {
+    pin = p;
+    return 0;
+  }
+  void detach(void) { pin = -1; }
+  bool attached(void) { return pin >= 0; }
+
+  void writeMicroseconds(int value) {
+    us = value;
+    if (pin >= 0 && pin < HOST_PINS)
+      hostServoUs[pin] = value;
+    hostServoWrites++;
+  }
+  int readMicroseconds(void) { return us; }
+};
+
+#endif // #ifndef HOST_SERVO_H
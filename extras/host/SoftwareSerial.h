@@ -0,0 +1,29 @@
+// ====================================================================================================
+//
+// Host stand-in for the SoftwareSerial library
+//
+
+#ifndef HOST_SOFTWARE_SERIAL_H
+#define HOST_SOFTWARE_SERIAL_H
+
+#include <Arduino.h>
+
+class SoftwareSerial : public HostStream {
+public:
+  static SoftwareSerial *active;    // the last port begun, so tests can reach the sketch's port
+
+  SoftwareSerial(uint8_t rxPin, uint8_t txPin) {
+    (void) rxPin;
+    (void) txPin;
+  }
+  void begin(long baud) {
+    (void) baud;
+    active = this;
+  }
+  void end(void) {}
+  bool listen(void) { return true; }
+  bool overflow(void) { return false; }
+  operator bool() { return true; }
+};
+
+#endif // #ifndef HOST_SOFTWARE_SERIAL_H
@@ -0,0 +1,115 @@
+// ====================================================================================================
+//
+// Host implementations of the Arduino core stand-ins
+//
+
+#include <Arduino.h>
+#include <Servo.h>
+#include <EEPROM.h>
+#include <SoftwareSerial.h>
+#include <time.h>
+
+uint8_t hostPinLevel[HOST_PINS];
+int hostAnalog[HOST_PINS];
+unsigned long hostServoWrites;
+int hostServoUs[HOST_PINS];
+
+volatile uint8_t host_ADMUX, host_ADCSRA, host_ADCL, host_ADCH, host_SREG;
+volatile uint8_t host_TCCR1A, host_TCCR1B, host_TIMSK1, host_TIFR1;
+volatile uint16_t host_OCR1B;
+HostTimer16 host_TCNT1;
+volatile uint8_t host_PORT[HOST_PINS];
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+SoftwareSerial *SoftwareSerial::active;
+
+static struct HostPins {
+  HostPins() {
+    for (int i=0; i < HOST_PINS; i++) {
+      hostPinLevel[i] = HIGH;
+      hostAnalog[i] = 512;
+    }
+    host_ADCL = 225;    // 5V for readVcc()
+    host_ADCH = 0x00;
+  }
+} hostPins;
+
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void) pin;
+  (void) mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < HOST_PINS)
+    hostPinLevel[pin] = level;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < HOST_PINS) ? hostPinLevel[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  return (pin < HOST_PINS) ? hostAnalog[pin] : 0;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+// Time.  Like the real thing micros() wraps at 32 bits
+
+static bool manualClock;
+static uint32_t manualUs, manualStep;
+
+static uint32_t hostUs(void) {
+  static struct timespec start;
+  struct timespec now;
+  if (start.tv_sec == 0)
+    clock_gettime(CLOCK_MONOTONIC, &start);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t) ((now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000);
+}
+
+void hostClock(bool manual, uint32_t us, uint32_t step) {
+  manualClock = manual;
+  manualUs = us;
+  manualStep = step;
+}
+
+void hostAdvance(uint32_t us) {
+  manualUs += us;
+}
+
+unsigned long micros(void) {
+  if (!manualClock)
+    return hostUs();
+  manualUs += manualStep;
+  return manualUs;
+}
+
+unsigned long millis(void) {
+  return micros() / 1000UL;
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (manualClock) {
+    manualUs += us;
+    return;
+  }
+  uint32_t start = hostUs();
+  while (hostUs() - start < us)
+    ;
+}
+
+void delay(unsigned long ms) {
+  if (manualClock) {
+    manualUs += ms * 1000UL;
+    return;
+  }
+  struct timespec ts = { (time_t) (ms / 1000), (long) (ms % 1000) * 1000000L };
+  nanosleep(&ts, nullptr);
+}
@@ -0,0 +1,141 @@
+// ====================================================================================================
+//
+// inoproto - turn a sketch (.ino) into a C++ file the way the Arduino builder does:
+// include Arduino.h and declare every top level function after the last top level
+// #include, so the sketch can call functions before they are defined.
+//
+// usage: inoproto <sketch.ino> <output.cpp>
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+static const char *notFunctions[] = {
+  "static", "struct", "class", "union", "enum", "typedef", "template", "namespace",
+  "if", "else", "while", "for", "switch", "do", "return", "case", "ISR"
+};
+
+// Count the braces on a line, skipping comments and literals.
+// 'comment' carries a /* */ comment over to the next line
+//
+static int braces(const std::string &line, bool &comment) {
+  int depth = 0;
+  for (size_t i=0; i < line.size(); i++) {
+    char c = line[i];
+    if (comment) {
+      if (c == '*' && i + 1 < line.size() && line[i + 1] == '/') {
+        comment = false;
+        i++;
+      }
+      continue;
+    }
+    if (c == '/' && i + 1 < line.size() && line[i + 1] == '/')
+      break;
+    if (c == '/' && i + 1 < line.size() && line[i + 1] == '*') {
+      comment = true;
+      i++;
+      continue;
+    }
+    if (c == '"' || c == '\'') {
+      for (i++; i < line.size() && line[i] != c; i++) {
+        if (line[i] == '\\')
+          i++;
+      }
+      continue;
+    }
+    if (c == '{')
+      depth++;
+    if (c == '}')
+      depth--;
+  }
+  return depth;
+}
+
+// Return the prototype for a top level line that starts a function definition, or ""
+//
+static std::string prototype(const std::string &line) {
+  if (line.empty() || !(isalpha((unsigned char) line[0]) || line[0] == '_'))
+    return "";
+
+  size_t paren = line.find('(');
+  size_t end = line.find_last_not_of(" \t\r");
+  if (paren == std::string::npos || end == std::string::npos || line[end] != '{')
+    return "";
+
+  std::string head = line.substr(0, paren);
+  if (head.find('=') != std::string::npos || head.find_first_of(" *&") == std::string::npos)
+    return "";
+  for (const char *word : notFunctions) {
+    size_t len = strlen(word);
+    if (head.compare(0, len, word) == 0 && (head.size() == len || !isalnum((unsigned char) head[len])))
+      return "";
+  }
+
+  // drop the body and any default argument values
+  std::string proto;
+  bool skipping = false;
+  int nesting = 0;
+  for (size_t i=0; i < line.rfind(')') + 1; i++) {
+    char c = line[i];
+    if (c == '(')
+      nesting++;
+    if (c == ')')
+      nesting--;
+    if (c == '=' && nesting == 1)
+      skipping = true;
+    if ((c == ',' && nesting == 1) || nesting == 0)
+      skipping = false;
+    if (!skipping)
+      proto += c;
+  }
+  return proto + ";";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <sketch.ino> <output.cpp>\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream in(argv[1]);
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  std::vector<std::string> lines;
+  std::vector<std::string> protos;
+  size_t lastInclude = 0;
+  int depth = 0;
+  bool comment = false;
+
+  for (std::string line; std::getline(in, line); ) {
+    lines.push_back(line);
+    if (depth == 0 && !comment) {
+      if (line.compare(0, 8, "#include") == 0)
+        lastInclude = lines.size();
+      std::string proto = prototype(line);
+      if (!proto.empty())
+        protos.push_back(proto);
+    }
+    depth += braces(line, comment);
+  }
+
+  std::ofstream out(argv[2]);
+  out << "#include <Arduino.h>\n";
+  out << "#line 1 \"" << argv[1] << "\"\n";
+  for (size_t i=0; i < lastInclude; i++)
+    out << lines[i] << "\n";
+  for (const std::string &proto : protos)
+    out << proto << "\n";
+  out << "#line " << lastInclude + 1 << " \"" << argv[1] << "\"\n";
+  for (size_t i=lastInclude; i < lines.size(); i++)
+    out << lines[i] << "\n";
+
+  return out ? 0 : 1;
+}
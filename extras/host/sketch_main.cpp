@@ -0,0 +1,14 @@
+// ====================================================================================================
+//
+// Run the sketch's setup() once on the host.  In the benchmark build that runs the
+// benchmarks and reports them on stdout; otherwise it checks that the sketch starts up
+//
+
+#include <Arduino.h>
+
+void setup(void);
+
+int main(void) {
+  setup();
+  return 0;
+}
@@ -0,0 +1,27 @@
+// ====================================================================================================
+//
+// Minimal checks for the host tests.  CHECK() reports a failure and keeps going;
+// each test's main() returns checkResult() so ctest sees any failures
+//
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+static int checkFailures;
+
+#define CHECK(cond) do {                                                    \
+    if (!(cond)) {                                                          \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);      \
+      checkFailures++;                                                      \
+    }                                                                       \
+  } while (0)
+
+static inline int checkResult(void) {
+  if (checkFailures != 0)
+    printf("%d check(s) failed\n", checkFailures);
+  return checkFailures != 0;
+}
+
+#endif // #ifndef HOST_CHECK_H
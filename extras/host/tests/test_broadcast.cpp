@@ -0,0 +1,303 @@
+// ====================================================================================================
+//
+// Host test of the leader/follower broadcast.  A leader and two chained followers are wired
+// together through loopback streams that deliver one byte per byte time at 115200 baud,
+// then the whole sketch is started as a follower from the role saved in its EEPROM
+//
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Servo.h>
+#include <SoftwareSerial.h>
+#include "mimic.h"
+#include "OutputArm.h"
+#include "Broadcast.h"
+#include "ButtonLib2.h"
+#include "check.h"
+
+void setup(void);
+void loop(void);
+
+#define BAUD      115200L
+#define BYTE_US   ((10 * 1000000L + BAUD - 1) / BAUD)
+#define POLL_US   300
+
+static Pos lowest(800, 650, 550, 550);
+static Pos highest(1600, 2300, 2280, 2365);
+static Limits leaderRange(lowest, highest);
+
+// A serial line from one unit's transmit queue to the next one's receive queue
+//
+struct Wire {
+  HostStream *from, *to;
+  uint32_t next;        // when the byte on the wire now has been received
+  bool drop;            // lose the next frame sent
+  int corrupt;          // flip a bit in this many bytes' time (-1 = no)
+  std::deque<uint8_t> garbage;    // received ahead of the next frame
+
+  void run(uint32_t now) {
+    if (from->tx->empty()) {
+      next = now + BYTE_US;
+      return;
+    }
+    if (drop && from->tx->size() >= BROADCAST_FRAME) {
+      from->tx->erase(from->tx->begin(), from->tx->begin() + BROADCAST_FRAME);
+      drop = false;
+      return;
+    }
+    if (!garbage.empty()) {
+      from->tx->insert(from->tx->begin(), garbage.begin(), garbage.end());
+      garbage.clear();
+    }
+    if ((int32_t) (now - next) < 0)
+      return;
+    uint8_t c = from->tx->front();
+    from->tx->pop_front();
+    if (corrupt == 0)
+      c ^= 0x10;
+    if (corrupt >= 0)
+      corrupt--;
+    to->rx->push_back(c);
+    next += BYTE_US;
+  }
+};
+
+// The chain: leader -> f1 -> f2
+//
+static Broadcast leader, f1, f2;
+static HostStream leaderPort, f1Port, f2Port;
+static Wire wire1 = { &leaderPort, &f1Port, 0, false, -1, {} };
+static Wire wire2 = { &f1Port, &f2Port, 0, false, -1, {} };
+
+// micros() when the leader last sent and each follower last forwarded a frame
+static uint32_t sentUs, f1Us, f2Us;
+
+// Times each follower has given up on the leader
+static int f1Expired, f2Expired;
+
+// Hold up the first follower for this long part way into the next frame
+static uint32_t f1Stall, f1StallStart;
+static bool f1Stalling;
+
+// Run the chain for 'ms' milliseconds in 10 uS steps.  The followers poll
+// every POLL_US, out of step with each other and with the leader
+//
+static void run(uint32_t ms, Pos &pos) {
+  uint32_t end = micros() + ms * 1000UL;
+  while ((int32_t) (micros() - end) < 0) {
+    uint32_t now = micros();
+    size_t queued = leaderPort.tx->size();
+    leader.send(leaderPort, pos, leaderRange);
+    if (leaderPort.tx->size() != queued) {
+      sentUs = now;
+      if (f1Stall != 0) {
+        f1StallStart = now + POLL_US + BYTE_US;
+        f1Stalling = true;
+      }
+    }
+    bool stalled = f1Stalling && now - f1StallStart < f1Stall;
+
+    wire1.run(now);
+    wire2.run(now);
+
+    if (now % POLL_US == 0 && !stalled && f1.poll(f1Port))
+      f1Us = now;
+    if (f1Stalling && now - f1StallStart == f1Stall)
+      f1Stalling = false;
+    if (now % POLL_US == 170 && f2.poll(f2Port))
+      f2Us = now;
+    f1Expired += f1.expired();
+    f2Expired += f2.expired();
+    hostAdvance(10);
+  }
+}
+
+// Scripted button for the sketch: three short presses starting at 'pressAt'
+//
+static uint32_t pressAt;
+
+static int scriptedButton(const char pin) {
+  (void) pin;
+  uint32_t ms = millis() - pressAt;
+  bool pressed = ms < 60 || (ms >= 150 && ms < 210) || (ms >= 300 && ms < 360);
+  return pressed ? LOW : HIGH;
+}
+
+// Send the sketch a command on its control port
+//
+static void command(char cmd, int value) {
+  SerialPacket pkt;
+  pkt.fields.cmd = cmd;
+  pkt.fields.value = value;
+  SoftwareSerial::active->inject(pkt.data, sizeof(pkt.data));
+  loop();
+}
+
+// Ask the sketch for its broadcast counters on the control port
+//
+struct Counters {
+  uint8_t role, hops;
+  uint16_t latency, hopLatency, received, dropped, errors;
+};
+
+static bool counters(Counters &c) {
+  SerialPacket pkt;
+  pkt.fields.cmd = 's';
+  pkt.fields.value = 0;
+  std::deque<uint8_t> &out = *SoftwareSerial::active->tx;
+  out.clear();
+  SoftwareSerial::active->inject(pkt.data, sizeof(pkt.data));
+  loop();
+  if (out.size() != 13 || out[0] != 's')
+    return false;
+  c.role = out[1];
+  c.hops = out[2];
+  c.latency = out[3] | (out[4] << 8);
+  c.hopLatency = out[5] | (out[6] << 8);
+  c.received = out[7] | (out[8] << 8);
+  c.dropped = out[9] | (out[10] << 8);
+  c.errors = out[11] | (out[12] << 8);
+  return true;
+}
+
+int main(void) {
+  hostClock(true, 1000000UL, 0);
+  leader.begin(BROADCAST_LEADER, BAUD);
+  f1.begin(BROADCAST_FOLLOWER, BAUD);
+  f2.begin(BROADCAST_FOLLOWER, BAUD);
+
+  // positions arrive as a fraction of the leader's range and
+  // map onto a follower's own range
+  Pos pos(1200, 650, 2280, 1000);
+  run(500, pos);
+  printf("chain: %u, %u frames  latency %u, %u x 10 uS\n",
+    f1.received, f2.received, f1.latency, f2.latency);
+  CHECK(f1.received >= 11 && f2.received >= 11);
+  CHECK(f1.hops == 1 && f2.hops == 2);
+  CHECK(f1.dropped == 0 && f2.dropped == 0 && f1.errors == 0 && f2.errors == 0);
+  CHECK(abs((int) f2.arm.pinch - BROADCAST_SCALE / 2) <= 1);
+  CHECK(f2.arm.wrist == 0 && f2.arm.elbow == BROADCAST_SCALE);
+
+  Pos low(500, 500, 500, 500);
+  Pos high(2500, 2500, 2500, 2500);
+  Limits followerRange(low, high);
+  OutputArm out(3, 5, 6, 9, followerRange);
+  out.setMode(Immediate);
+  out = f2.arm;
+  out.write();
+  CHECK(abs((int) out.pinch - 1500) <= 1 && out.wrist == 500 && out.elbow == 2500);
+
+  // each hop is timed from when its frame started to arrive, including the time
+  // it sat in the receive buffer waiting for a poll, give or take a byte time
+  uint32_t hop1 = f1Us - sentUs;
+  uint32_t hop2 = f2Us - sentUs;
+  printf("truth: %lu, %lu uS\n", (unsigned long) hop1, (unsigned long) hop2);
+  CHECK(hop1 > BROADCAST_FRAME * BYTE_US);
+  CHECK(abs((int) f1.latency * BROADCAST_TICK_US - (int) hop1) <= BYTE_US + BROADCAST_TICK_US);
+  CHECK(abs((int) f2.latency * BROADCAST_TICK_US - (int) hop2) <= 2 * (BYTE_US + BROADCAST_TICK_US));
+  CHECK(f2.latency > f2.hopLatency && f2.hopLatency > 0);
+
+  // a follower held up after the frame started to arrive counts the wait
+  f1Stall = 5000;
+  run(BROADCAST_MS, pos);
+  f1Stall = 0;
+  hop1 = f1Us - sentUs;
+  printf("stalled: %u x 10 uS  truth %lu uS\n", f1.latency, (unsigned long) hop1);
+  CHECK(hop1 > f1Stall);
+  CHECK(abs((int) f1.latency * BROADCAST_TICK_US - (int) hop1) <= BYTE_US + BROADCAST_TICK_US);
+
+  // a lost frame is counted as dropped all the way down the chain
+  wire1.drop = true;
+  run(100, pos);
+  CHECK(f1.dropped == 1 && f2.dropped == 1);
+
+  // a corrupt frame is counted as bad and the next one is taken
+  uint16_t received = f1.received;
+  wire1.corrupt = 6;
+  run(100, pos);
+  CHECK(f1.errors == 1 && f2.errors == 0);
+  CHECK(f1.received >= received + 1);
+  CHECK(f2.dropped == 2);
+
+  // a false sync in the line noise doesn't cost the real frame behind it
+  received = f1.received;
+  uint16_t dropped = f1.dropped;
+  wire1.garbage = { 0x00, BROADCAST_SYNC, 0x12 };
+  run(50, pos);
+  CHECK(f1.errors == 2);
+  CHECK(f1.received > received && f1.dropped == dropped);
+  CHECK(f1Expired == 0 && f2Expired == 0);
+
+  // the followers give up on a leader that goes quiet, once, and
+  // aren't thrown by it starting its sequence again
+  leader.begin(BROADCAST_OFF, BAUD);
+  run(BROADCAST_TIMEOUT_MS + BROADCAST_MS, pos);
+  CHECK(f1Expired == 1 && f2Expired == 1);
+  run(BROADCAST_TIMEOUT_MS, pos);
+  CHECK(f1Expired == 1 && f2Expired == 1);
+
+  received = f2.received;
+  dropped = f2.dropped;
+  leader.begin(BROADCAST_LEADER, BAUD);
+  run(100, pos);
+  printf("restart: %u dropped\n", f2.dropped - dropped);
+  CHECK(f2.received > received && f1.dropped == 2 && f2.dropped == dropped);
+
+  // the sketch comes back as a follower from the role saved in its EEPROM and
+  // takes frames on the Serial port while its control port still answers
+  EEPROM.write(BROADCAST_ROLE_ADDR, BROADCAST_FOLLOWER);
+  hostClock(true, 1000000UL, 1);
+  Serial.echo = false;
+  HostStream upstream;
+  Serial.connect(upstream);
+  setup();
+
+  Counters c;
+  CHECK(counters(c) && c.role == BROADCAST_FOLLOWER && c.received == 0);
+
+  Serial.tx->clear();
+  leader.begin(BROADCAST_LEADER, BAUD);
+  hostAdvance(BROADCAST_MS * 1000UL);
+  leader.send(upstream, pos, leaderRange);
+  loop();
+  CHECK(counters(c) && c.received == 1 && c.hops == 1 && c.errors == 0);
+  CHECK(Serial.tx->size() == BROADCAST_FRAME && Serial.tx->front() == BROADCAST_SYNC && (*Serial.tx)[2] == 1);
+
+  // when the leader stops part way through a move the arm stays where the
+  // last frame put it, and the leader starting over isn't counted as drops
+  command('M', 0);
+  for (int i=0; i < 5; i++) {
+    Pos moving(1200, 650 + i * 100, 2280, 1000);
+    hostAdvance(BROADCAST_MS * 1000UL);
+    leader.send(upstream, moving, leaderRange);
+    loop();
+  }
+  uint32_t stopped = millis();
+  while (millis() - stopped < BROADCAST_TIMEOUT_MS + 10)
+    loop();
+  int held[4] = { hostServoUs[3], hostServoUs[5], hostServoUs[6], hostServoUs[9] };
+  printf("hold: wrist %d uS after the leader stops at 1050 uS\n", held[1]);
+  CHECK(abs(held[1] - 1050) <= 2);
+  while (millis() - stopped < 1000)
+    loop();
+  CHECK(hostServoUs[3] == held[0] && hostServoUs[5] == held[1]);
+  CHECK(hostServoUs[6] == held[2] && hostServoUs[9] == held[3]);
+
+  leader.begin(BROADCAST_LEADER, BAUD);
+  hostAdvance(BROADCAST_MS * 1000UL);
+  leader.send(upstream, pos, leaderRange);
+  loop();
+  CHECK(counters(c) && c.received == 7 && c.dropped == 0);
+
+  // three short presses step the role on to off, and it is saved
+  Serial.tx->clear();
+  pressAt = millis() + 5;
+  set_button_read_callback(scriptedButton);
+  while (millis() < pressAt + 1000)
+    loop();
+  set_button_read_callback(nullptr);
+  CHECK(counters(c) && c.role == BROADCAST_OFF);
+  CHECK(EEPROM.read(BROADCAST_ROLE_ADDR) == BROADCAST_OFF);
+
+  return checkResult();
+}
@@ -0,0 +1,152 @@
+// ====================================================================================================
+//
+// Host test of the Predict update mode: a joint is driven from noisy readings once
+// a millisecond, the way mimic() does, and the servo position is compared with where
+// the hand will be DEFAULT_LEAD milliseconds later (when the servo gets there)
+//
+
+#include <Arduino.h>
+#include "OutputArm.h"
+#include "check.h"
+
+static Pos lowest(500, 500, 500, 500);
+static Pos highest(2500, 2500, 2500, 2500);
+static Limits range(lowest, highest);
+
+struct Result {
+  int maxError;
+  unsigned long writes;
+};
+
+// repeatable noise in -amp..amp
+static int noise(int amp) {
+  static uint32_t seed = 1;
+  seed = seed * 1103515245UL + 12345UL;
+  return (int) ((seed >> 16) % (2 * amp + 1)) - amp;
+}
+
+static int ramp(int ms)  { return 1000 + 5 * ms; }
+static int still(int ms) { return 1500 + 0 * ms; }
+static int wave(int ms)  { return 1500 + (int) (400.0 * sin(ms * 2.0 * M_PI / 1000.0)); }
+
+// Move the waist along 'truth' for 'ms' milliseconds with readings that are
+// off by up to 'amp'. The error and the servo writes are counted from 'from'
+//
+static Result run(UpdateMode mode, int deadband, int (*truth)(int), int amp, int ms, int from) {
+  hostClock(true, 1000000UL, 0);
+
+  Arm in(0, 1, 2, 3, range);
+  OutputArm out(3, 5, 6, 9, range);
+  in.pinch = in.wrist = in.elbow = 1500;
+  out.setMode(mode);
+  out.gains.deadband = deadband;
+
+  Result result = { 0, 0 };
+  unsigned long writes = 0;
+  for (int t=0; t < ms; t++) {
+    in.waist = truth(t) + noise(amp);
+    out = in;
+    out.write();
+
+    if (t == from)
+      writes = hostServoWrites;
+    if (t >= from) {
+      int error = abs((int) out.waist - truth(t + DEFAULT_LEAD));
+      if (error > result.maxError)
+        result.maxError = error;
+    }
+    hostAdvance(1000);
+  }
+  result.writes = hostServoWrites - writes;
+  return result;
+}
+
+int main(void) {
+  // a steady 5 uS/mS move: the deadband must not cost us the velocity
+  Result half = run(IncrementHalf, DEFAULT_DEADBAND, ramp, 2, 200, 50);
+  Result predict = run(Predict, DEFAULT_DEADBAND, ramp, 2, 200, 50);
+  Result open = run(Predict, 0, ramp, 2, 200, 50);
+  printf("ramp:  IncrementHalf %3d uS   Predict %3d uS   Predict (no deadband) %3d uS\n",
+    half.maxError, predict.maxError, open.maxError);
+  CHECK(predict.maxError <= 12);
+  CHECK(predict.maxError * 4 < half.maxError);
+  CHECK(predict.maxError <= open.maxError + DEFAULT_DEADBAND);
+
+  // a hand waving at 1 Hz
+  half = run(IncrementHalf, DEFAULT_DEADBAND, wave, 2, 2000, 500);
+  predict = run(Predict, DEFAULT_DEADBAND, wave, 2, 2000, 500);
+  printf("wave:  IncrementHalf %3d uS   Predict %3d uS\n", half.maxError, predict.maxError);
+  CHECK(predict.maxError * 2 < half.maxError);
+
+  // a still hand: the noise is held off the servo
+  half = run(IncrementHalf, DEFAULT_DEADBAND, still, 3, 1000, 200);
+  predict = run(Predict, DEFAULT_DEADBAND, still, 3, 1000, 200);
+  printf("still: IncrementHalf %3d uS %3lu writes   Predict %3d uS %3lu writes\n",
+    half.maxError, half.writes, predict.maxError, predict.writes);
+  CHECK(predict.maxError <= DEFAULT_DEADBAND);
+  CHECK(predict.writes * 10 < half.writes);
+
+  // direct joint writes and timed moves are not pulled back by the filter
+  hostClock(true, 1000000UL, 0);
+  Arm in(0, 1, 2, 3, range);
+  OutputArm out(3, 5, 6, 9, range);
+  in.pinch = in.wrist = in.elbow = 1500;
+  out.setMode(Predict);
+  for (int t=0; t < 50; t++) {
+    in.waist = ramp(t);
+    out = in;
+    out.write();
+    hostAdvance(1000);
+  }
+
+  out.writeJoint(WaistJoint, 1234);
+  for (int t=0; t < 20; t++) {
+    hostAdvance(1000);
+    out.write();
+  }
+  CHECK(out.waist == 1234);
+
+  Pos pos(1100, 1200, 1300, 1400);
+  out.write(pos);
+  for (int t=0; t < 20; t++) {
+    hostAdvance(1000);
+    out.write();
+  }
+  CHECK(out.pinch == 1100 && out.wrist == 1200 && out.elbow == 1300 && out.waist == 1400);
+
+  // when the readings stop the arm settles on the last ones, however long it waits
+  out.setMode(Predict);
+  for (int t=0; t < 50; t++) {
+    in.waist = ramp(t);
+    in.elbow = ramp(t) / 2;
+    out = in;
+    out.write();
+    hostAdvance(1000);
+  }
+  int lastWaist = ramp(49);
+  int lastElbow = ramp(49) / 2;
+  hostAdvance(PREDICT_STALE_US);
+  out.write();
+  printf("stop:  waist %4u uS after the readings stop at %4d uS\n", out.waist, lastWaist);
+  CHECK(out.waist == lastWaist && out.elbow == lastElbow);
+
+  const uint32_t minutes = 60UL * 1000000UL;
+  for (int t=0; t < 70; t++) {
+    hostAdvance(minutes);
+    out.write();
+    CHECK(out.waist == lastWaist && out.elbow == lastElbow && out.pinch == 1500);
+  }
+
+  // a joint written long after the last reading moves alone, and the
+  // readings taken after that start the filters afresh
+  hostAdvance(40 * minutes);
+  out.writeJoint(WaistJoint, 1500);
+  CHECK(out.waist == 1500 && out.elbow == lastElbow && out.wrist == 1500 && out.pinch == 1500);
+  hostAdvance(40 * minutes);
+  in.waist = 1600;
+  out = in;
+  out.write();
+  CHECK(out.waist == 1600 && out.elbow == lastElbow);
+
+  return checkResult();
+}
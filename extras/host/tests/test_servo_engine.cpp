@@ -0,0 +1,189 @@
+// ====================================================================================================
+//
+// Host test of the ServoEngine interrupt: Timer1 is stepped one tick at a time, service()
+// is called whenever it reaches OCR1B the way the compare B interrupt would be, and the
+// output pins are watched to measure every pulse in every frame
+//
+
+#include <Arduino.h>
+#include "ServoEngine.h"
+#include "check.h"
+
+static const uint8_t pins[ENGINE_JOINTS] = { 3, 5, 6, 9 };
+
+// The pulses seen in the last complete frame, in timer ticks
+//
+struct Frame {
+  uint16_t width[ENGINE_JOINTS];
+  bool seen;
+};
+
+// The output pins as last seen, and the narrowest pulse seen since 'shortest'
+// was last reset (in microseconds at the timer rate the pulse started with)
+//
+static uint16_t rise[ENGINE_JOINTS];
+static uint8_t level[ENGINE_JOINTS], riseTicksPerUs[ENGINE_JOINTS];
+static int shortest;
+
+// Run the timer until 'count' frames have started and return the last complete one
+//
+static Frame run(ServoEngine &engine, int count) {
+  Frame frame, last;
+  memset(&frame, 0, sizeof(frame));
+  memset(&last, 0, sizeof(last));
+
+  uint32_t start = engine.frames();
+  while (engine.frames() - start < (uint32_t) count) {
+    host_TCNT1.value++;
+    if (host_TCNT1.value == host_OCR1B) {
+      uint32_t frames = engine.frames();
+      engine.service();
+      if (engine.frames() != frames) {
+        last = frame;
+        memset(&frame, 0, sizeof(frame));
+      }
+    }
+
+    // the timer has moved on by however long service() kept reading it
+    for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+      uint8_t now = host_PORT[pins[i]];
+      if (now && !level[i]) {
+        rise[i] = host_TCNT1.value;
+        riseTicksPerUs[i] = (host_TCCR1B & _BV(CS11)) ? 2 : 16;
+      }
+      if (!now && level[i]) {
+        frame.width[i] = host_TCNT1.value - rise[i];
+        frame.seen = true;
+        shortest = min(shortest, frame.width[i] / riseTicksPerUs[i]);
+      }
+      level[i] = now;
+    }
+  }
+  return last;
+}
+
+// Check every pulse in a frame is within 'slack' microseconds of 'us'
+//
+static bool matches(const Frame &frame, const uint16_t *us, int ticksPerUs, int slack) {
+  if (!frame.seen)
+    return false;
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    if (abs(frame.width[i] / ticksPerUs - (int) us[i]) > slack)
+      return false;
+  }
+  return true;
+}
+
+static void print(const char *name, const Frame &frame, int ticksPerUs) {
+  printf("%-6s", name);
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    printf(" %5d uS", frame.width[i] / ticksPerUs);
+  }
+  printf("\n");
+}
+
+int main(void) {
+  host_TCNT1.autoTick = true;
+  host_TCNT1.value = 0;
+
+  // wide pulses at the fastest frame rate: the timer runs with no prescaler
+  // so every one of them ends over 32767 ticks after the frame starts
+  static ServoEngine engine;
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    engine.attach(i, pins[i]);
+  }
+  engine.begin(ENGINE_MAX_HZ);
+  CHECK(engine.isRunning());
+
+  uint16_t wide[ENGINE_JOINTS] = { 2100, 2300, 2280, 2365 };
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    engine.write(i, wide[i]);
+  }
+  engine.commit();
+  Frame frame = run(engine, 5);
+  print("333Hz", frame, 16);
+  CHECK(matches(frame, wide, 16, 1));
+
+  // widths that end within ENGINE_GAP_US of each other are ended from one interrupt
+  // (only the last edge is seen here, each pin really falls when it is due)
+  uint16_t close[ENGINE_JOINTS] = { 1000, 1005, 1010, 2600 };
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    engine.write(i, close[i]);
+  }
+  engine.commit();
+  frame = run(engine, 3);
+  print("close", frame, 16);
+  CHECK(matches(frame, close, 16, ENGINE_GAP_US));
+  CHECK(frame.width[3] / 16 == close[3]);
+
+  // analog servos: 50 Hz with the prescaler
+  engine.begin(ENGINE_MIN_HZ);
+  uint16_t analog[ENGINE_JOINTS] = { 800, 1500, 2000, 2500 };
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    engine.write(i, analog[i]);
+  }
+  engine.commit();
+  frame = run(engine, 3);
+  print("50Hz", frame, 2);
+  CHECK(matches(frame, analog, 2, 1));
+
+  // a set staged over several calls is only picked up whole, at a frame boundary
+  uint32_t commits = engine.commits();
+  engine.write(0, 1200);
+  engine.write(1, 1300);
+  run(engine, 2);
+  CHECK(engine.commits() == commits);
+  engine.write(2, 1400);
+  engine.write(3, 1500);
+  engine.commit();
+  frame = run(engine, 3);
+  uint16_t set[ENGINE_JOINTS] = { 1200, 1300, 1400, 1500 };
+  CHECK(matches(frame, set, 2, 1));
+  CHECK(engine.commits() == commits + 1);
+
+  // a new frame rate given part way through a frame starts at the next frame
+  // boundary: the pulses already started run their full width
+  uint16_t steady[ENGINE_JOINTS] = { 1000, 1200, 1400, 1600 };
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    engine.write(i, steady[i]);
+  }
+  engine.commit();
+  run(engine, 3);
+  shortest = ENGINE_MAX_US;
+  uint16_t middle = host_OCR1B - 500 * 2;      // half way through the first pulse
+  while (host_TCNT1.value != middle)
+    host_TCNT1.value++;
+  CHECK(host_PORT[pins[0]] != 0);
+  engine.begin(ENGINE_MAX_HZ);
+  CHECK(engine.isRunning());
+  run(engine, 1);
+  frame = run(engine, 3);
+  print("333Hz", frame, 16);
+  printf("shortest pulse across the change: %d uS\n", shortest);
+  CHECK(shortest >= steady[0] - 1);
+  CHECK(matches(frame, steady, 16, 1));
+
+  shortest = ENGINE_MAX_US;
+  middle = host_OCR1B - 500 * 16;
+  while (host_TCNT1.value != middle)
+    host_TCNT1.value++;
+  CHECK(host_PORT[pins[0]] != 0);
+  engine.begin(ENGINE_MIN_HZ);
+  frame = run(engine, 3);
+  CHECK(shortest >= steady[0] - 1);
+  CHECK(matches(frame, steady, 2, 1));
+
+  // starting the engine takes Timer1 from the Servo library's compare A interrupt
+  engine.end();
+  host_TIMSK1 |= _BV(OCIE1A);
+  engine.begin(ENGINE_MIN_HZ);
+  CHECK(!(host_TIMSK1 & _BV(OCIE1A)) && (host_TIMSK1 & _BV(OCIE1B)));
+
+  // stopping leaves every pin low
+  engine.end();
+  for (uint8_t i=0; i < ENGINE_JOINTS; i++) {
+    CHECK(host_PORT[pins[i]] == 0);
+  }
+
+  return checkResult();
+}
@@ -0,0 +1,232 @@
+// ====================================================================================================
+//
+// Host test of trace record and replay through the whole sketch (built with TRACE_ENABLE).
+// A session longer than the trace holds is recorded from scripted pot movements and text
+// commands without changing a single servo output, the sketch is put into a different
+// state, and every replay from the oldest keyframe must come out the same and match the
+// servo positions saved in the later keyframes
+//
+
+#include <Arduino.h>
+#include <Servo.h>
+#include <stddef.h>
+#include <SoftwareSerial.h>
+#include "mimic.h"
+#include "Trace.h"
+#include "check.h"
+
+void setup(void);
+void loop(void);
+
+static const int servoPins[4] = { 3, 5, 6, 9 };
+
+static uint32_t sessionStart;
+
+// The pots during the session (timed from its start): smooth moves on every
+// joint, a jump too big for one event at 2200 mS, and a hand held still from
+// 2600 to 2900 mS
+//
+static void sessionPots(uint32_t ms) {
+  ms = (ms > sessionStart) ? ms - sessionStart : 0;
+  if (ms >= 2600 && ms < 2900)
+    ms = 2600;
+  int wave = (int) (100.0 * sin(ms * 2.0 * M_PI / 700.0));
+  hostAnalog[A0] = 400 + wave;
+  hostAnalog[A1] = 350 - wave;
+  hostAnalog[A2] = 400 + wave / 2;
+  hostAnalog[A3] = (ms < 2200) ? 200 + wave : 550 + wave;
+}
+
+// Somewhere else entirely, so the replay can't be using the real pots
+//
+static void otherPots(uint32_t ms) {
+  (void) ms;
+  hostAnalog[A0] = 800;
+  hostAnalog[A1] = 120;
+  hostAnalog[A2] = 700;
+  hostAnalog[A3] = 100;
+}
+
+// Fold the servo positions into a running FNV-1a hash when they change,
+// so the hash follows the moves however many loop passes each one took
+//
+static int lastUs[4];
+
+static uint32_t startHash(void) {
+  memset(lastUs, 0, sizeof(lastUs));
+  return 2166136261UL;
+}
+
+static uint32_t hashServos(uint32_t hash) {
+  bool moved = false;
+  for (int j=0; j < 4; j++) {
+    moved |= (hostServoUs[servoPins[j]] != lastUs[j]);
+    lastUs[j] = hostServoUs[servoPins[j]];
+  }
+  for (int j=0; moved && j < 4; j++) {
+    hash = (hash ^ (uint32_t) lastUs[j]) * 16777619UL;
+  }
+  return hash;
+}
+
+// Run the sketch's loop once a millisecond for 'ms' milliseconds or until
+// 'reply' arrives on the control port.  The servo moves are hashed into
+// 'hash' if it is given
+//
+static bool run(uint32_t ms, void (*pots)(uint32_t), int reply = -1, uint32_t *hash = nullptr) {
+  std::deque<uint8_t> &out = *SoftwareSerial::active->tx;
+  uint32_t end = millis() + ms;
+  while (millis() < end) {
+    pots(millis());
+    loop();
+    if (hash != nullptr)
+      *hash = hashServos(*hash);
+    hostAdvance(1000);
+    if (reply >= 0 && std::find(out.begin(), out.end(), reply) != out.end())
+      return true;
+  }
+  return false;
+}
+
+// Send a command through the text api
+//
+static void command(const char *text) {
+  Serial.inject(text, strlen(text));
+  loop();
+}
+
+// Send a command packet to the control port followed by some raw bytes
+//
+static void packet(char cmd, int value, const std::deque<uint8_t> &raw) {
+  SerialPacket pkt;
+  pkt.fields.cmd = cmd;
+  pkt.fields.value = value;
+  SoftwareSerial::active->inject(pkt.data, sizeof(pkt.data));
+  SoftwareSerial::active->rx->insert(SoftwareSerial::active->rx->end(), raw.begin(), raw.end());
+  loop();
+}
+
+// Put the arm straight onto the pots at the start of the session, then run
+// it with fresh filters and return the hash of the servo moves.  It is
+// recorded if 'record' is true
+//
+static uint32_t session(bool record) {
+  sessionStart = 0xFFFFFFFFUL;      // hold the pots at the start
+  command("U0");
+  command("F128");
+  run(500, sessionPots);
+  command(record ? "T1" : "T0");
+  command("U4");
+  sessionStart = millis();
+
+  uint32_t hash = startHash();
+  run(2500, sessionPots, -1, &hash);
+  command("F100");
+  run(800, sessionPots, -1, &hash);
+  if (record)
+    command("T0");
+  return hash;
+}
+
+struct Replay {
+  int mismatches, worst;
+  uint32_t hash;
+};
+
+// Replay the trace.  The mismatches are -1 if it never finishes
+//
+static Replay replay(void) {
+  std::deque<uint8_t> &out = *SoftwareSerial::active->tx;
+  Replay result = { -1, 0, startHash() };
+  out.clear();
+  command("T2");
+  if (!run(10000, otherPots, 'r', &result.hash))
+    return result;
+  run(5, otherPots);
+
+  auto r = std::find(out.begin(), out.end(), 'r');
+  if (out.end() - r < 5)
+    return result;
+  result.mismatches = r[1] | (r[2] << 8);
+  result.worst = r[3] | (r[4] << 8);
+  return result;
+}
+
+int main(void) {
+  hostClock(true, 1000000UL, 1);
+  Serial.echo = false;
+  sessionPots(0);
+  setup();
+  std::deque<uint8_t> &out = *SoftwareSerial::active->tx;
+  command("M0");
+
+  // recording only watches: the session drives the servos exactly the same
+  // either way.  The clock only moves with the loop so extra calls to it
+  // while recording can't make a difference
+  hostClock(true, micros(), 0);
+  uint32_t live = session(false);
+  uint32_t recorded = session(true);
+  CHECK(live == recorded);
+  hostClock(true, micros(), 1);
+
+  // the trace holds the end of the session, from its oldest keyframe
+  out.clear();
+  command("T3");
+  CHECK(out.size() > 5 && out[0] == 'T');
+  uint8_t keys = out[1];
+  uint8_t count = out[2];
+  CHECK(keys >= 2 && keys <= TRACE_KEYS);
+  CHECK(count > TRACE_EVENTS - TRACE_KEY_EVENTS && count <= TRACE_EVENTS);
+  CHECK(out[3] == sizeof(TraceKey) && out[4] == sizeof(TraceEvent));
+  CHECK(out.size() == 5 + keys * sizeof(TraceKey) + count * sizeof(TraceEvent));
+  std::deque<uint8_t> raw(out.begin() + 1, out.end());
+
+  size_t eventsAt = 4 + keys * sizeof(TraceKey);
+  int types[TRACE_COMMAND + 1] = { 0 };
+  for (size_t i=0; i < count; i++) {
+    uint8_t type = raw[eventsAt + i * sizeof(TraceEvent) + 1];
+    CHECK(type <= TRACE_COMMAND);
+    if (type <= TRACE_COMMAND)
+      types[type]++;
+  }
+  printf("trace: %d keyframes, %d events: %d input, %d part, %d wait, %d command\n", keys, count,
+    types[TRACE_INPUT], types[TRACE_INPUT_PART], types[TRACE_WAIT], types[TRACE_COMMAND]);
+  CHECK(raw[4] == 0 && raw[5] == 0);
+  CHECK(types[TRACE_INPUT] > 10);
+  CHECK(types[TRACE_INPUT_PART] > 0);
+  CHECK(types[TRACE_WAIT] > 0);
+  CHECK(types[TRACE_COMMAND] == 1);
+
+  // put the sketch in a different state: other gains, update mode, app mode and pots
+  command("F200");
+  command("U2");
+  command("M1");
+  run(100, otherPots);
+
+  // every replay comes out the same, and close to the live session
+  Replay first = replay();
+  printf("replay: %d mismatches, worst %d uS\n", first.mismatches, first.worst);
+  CHECK(first.mismatches == 0 && first.worst <= TRACE_TOLERANCE);
+  command("U2");
+  run(100, otherPots);
+  Replay second = replay();
+  CHECK(second.mismatches == 0 && second.worst == first.worst && second.hash == first.hash);
+
+  // a trace with a changed servo position in its last keyframe
+  // uploads and shows up as one mismatch
+  raw[4 + (keys - 1) * sizeof(TraceKey) + offsetof(TraceKey, output) + 1] ^= 0x02;
+  out.clear();
+  packet('O', 0, raw);
+  CHECK(out.size() == 2 && out[0] == 'O' && out[1] == 1);
+  Replay altered = replay();
+  printf("altered replay: %d mismatches\n", altered.mismatches);
+  CHECK(altered.mismatches == 1 && altered.hash == first.hash);
+
+  // a trace that doesn't fit is refused
+  raw[1] = TRACE_EVENTS + 1;
+  out.clear();
+  packet('O', 0, raw);
+  CHECK(out.size() == 2 && out[0] == 'O' && out[1] == 0);
+
+  return checkResult();
+}